@@ -0,0 +1,172 @@
+#include "alloc.h"
+#include "profiler.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Tagged allocators. Every call is counted against its tag through the
+// profiler, so STALKER_PROFILE alone reports allocations and bytes per frame.
+// Building with STALKER_TRACK_ALLOC also prefixes each block with its size
+// and tag so frees can be attributed, which adds live and peak bytes per tag.
+// Memory from these functions must only be released with tracked_free, and
+// tracked_free must only be given memory from these functions.
+
+const char *ALLOC_TAG_NAMES[NUM_ALLOC_TAGS] = {
+    [ALLOC_BODY] = "body",
+    [ALLOC_FORCE] = "force",
+    [ALLOC_COLLISION] = "collision",
+    [ALLOC_LIST] = "list",
+    [ALLOC_RENDER] = "render"};
+
+const profile_counter_t TAG_COUNTERS[NUM_ALLOC_TAGS] = {
+    [ALLOC_BODY] = COUNT_BODY_ALLOCATIONS,
+    [ALLOC_FORCE] = COUNT_FORCE_ALLOCATIONS,
+    [ALLOC_COLLISION] = COUNT_COLLISION_ALLOCATIONS,
+    [ALLOC_LIST] = COUNT_LIST_ALLOCATIONS,
+    [ALLOC_RENDER] = COUNT_RENDER_ALLOCATIONS};
+
+#ifdef STALKER_TRACK_ALLOC
+// padded so the memory after it is aligned for any type
+typedef union alloc_header {
+  struct {
+    size_t size;
+    alloc_tag_t tag;
+  } block;
+  max_align_t alignment;
+} alloc_header_t;
+
+// atomic because the batch runner allocates from many threads
+typedef struct tag_stats {
+  atomic_size_t allocations;
+  atomic_size_t frees;
+  atomic_size_t bytes;
+  atomic_size_t live;
+  atomic_size_t peak;
+} tag_stats_t;
+
+tag_stats_t stats[NUM_ALLOC_TAGS];
+
+void track(alloc_tag_t tag, size_t size) {
+  tag_stats_t *tag_stats = &stats[tag];
+  atomic_fetch_add_explicit(&tag_stats->allocations, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&tag_stats->bytes, size, memory_order_relaxed);
+  size_t live = atomic_fetch_add_explicit(&tag_stats->live, size,
+                                          memory_order_relaxed) +
+                size;
+  size_t peak = atomic_load_explicit(&tag_stats->peak, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&tag_stats->peak, &peak, live,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+void untrack(alloc_tag_t tag, size_t size) {
+  atomic_fetch_add_explicit(&stats[tag].frees, 1, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&stats[tag].live, size, memory_order_relaxed);
+}
+#endif
+
+void count_allocation(alloc_tag_t tag, size_t size) {
+  profiler_count(COUNT_ALLOCATIONS, 1);
+  profiler_count(COUNT_ALLOCATED_BYTES, size);
+  profiler_count(TAG_COUNTERS[tag], 1);
+}
+
+void *tracked_malloc(size_t size, alloc_tag_t tag) {
+  count_allocation(tag, size);
+#ifdef STALKER_TRACK_ALLOC
+  alloc_header_t *header = malloc(sizeof(alloc_header_t) + size);
+  if (header == NULL) {
+    return NULL;
+  }
+  header->block.size = size;
+  header->block.tag = tag;
+  track(tag, size);
+  return header + 1;
+#else
+  return malloc(size);
+#endif
+}
+
+void *tracked_calloc(size_t number, size_t size, alloc_tag_t tag) {
+  void *out = tracked_malloc(number * size, tag);
+  if (out != NULL) {
+    memset(out, 0, number * size);
+  }
+  return out;
+}
+
+void *tracked_realloc(void *pointer, size_t size, alloc_tag_t tag) {
+  if (pointer == NULL) {
+    return tracked_malloc(size, tag);
+  }
+  count_allocation(tag, size);
+#ifdef STALKER_TRACK_ALLOC
+  alloc_header_t *header = (alloc_header_t *)pointer - 1;
+  untrack(header->block.tag, header->block.size);
+  header = realloc(header, sizeof(alloc_header_t) + size);
+  if (header == NULL) {
+    return NULL;
+  }
+  header->block.size = size;
+  header->block.tag = tag;
+  track(tag, size);
+  return header + 1;
+#else
+  return realloc(pointer, size);
+#endif
+}
+
+void tracked_free(void *pointer) {
+  if (pointer == NULL) {
+    return;
+  }
+#ifdef STALKER_TRACK_ALLOC
+  alloc_header_t *header = (alloc_header_t *)pointer - 1;
+  untrack(header->block.tag, header->block.size);
+  free(header);
+#else
+  free(pointer);
+#endif
+}
+
+bool alloc_is_tracking(void) {
+#ifdef STALKER_TRACK_ALLOC
+  return true;
+#else
+  return false;
+#endif
+}
+
+// totals since startup; all zero unless built with STALKER_TRACK_ALLOC
+alloc_stats_t alloc_get_stats(alloc_tag_t tag) {
+#ifdef STALKER_TRACK_ALLOC
+  return (alloc_stats_t){.allocations = atomic_load(&stats[tag].allocations),
+                         .frees = atomic_load(&stats[tag].frees),
+                         .bytes = atomic_load(&stats[tag].bytes),
+                         .live = atomic_load(&stats[tag].live),
+                         .peak = atomic_load(&stats[tag].peak)};
+#else
+  return (alloc_stats_t){0};
+#endif
+}
+
+const char *alloc_tag_name(alloc_tag_t tag) { return ALLOC_TAG_NAMES[tag]; }
+
+void alloc_print(FILE *out) {
+  if (!alloc_is_tracking()) {
+    return;
+  }
+  fprintf(out, "%-12s %12s %12s %14s %12s %12s\n", "tag", "allocations",
+          "frees", "bytes", "live", "peak");
+  for (size_t t = 0; t < NUM_ALLOC_TAGS; t++) {
+    alloc_stats_t tag_stats = alloc_get_stats(t);
+    fprintf(out, "%-12s %12zu %12zu %14zu %12zu %12zu\n", ALLOC_TAG_NAMES[t],
+            tag_stats.allocations, tag_stats.frees, tag_stats.bytes,
+            tag_stats.live, tag_stats.peak);
+  }
+}
@@ -0,0 +1,177 @@
+#include "batch.h"
+#include "rng.h"
+#include "sdl_wrapper.h"
+#include "state.h"
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// every game in a batch advances at this frame step
+const double BATCH_FRAME_STEP = 1.0 / 60;
+// mean seconds between the random policy's direction changes
+const double POLICY_INTERVAL = 0.75;
+
+typedef struct run_result {
+  bool won;
+  bool finished;
+  size_t coins;
+  double survived;
+  size_t frames;
+} run_result_t;
+
+// runs are independent; workers claim them through next_run, so the only
+// shared write is that counter and each result lands in its own slot
+typedef struct batch {
+  size_t runs;
+  size_t threads;
+  double seconds;
+  uint64_t *seeds;
+  run_result_t *results;
+  atomic_size_t next_run;
+  double wall_seconds;
+} batch_t;
+
+batch_t *batch_init(size_t runs, size_t threads, double seconds,
+                    uint64_t seed) {
+  assert(runs > 0);
+  assert(threads > 0);
+  batch_t *out = malloc(sizeof(batch_t));
+  assert(out != NULL);
+  out->runs = runs;
+  out->threads = threads;
+  out->seconds = seconds;
+  out->seeds = malloc(sizeof(uint64_t) * runs);
+  out->results = malloc(sizeof(run_result_t) * runs);
+  assert(out->seeds != NULL);
+  assert(out->results != NULL);
+  // seeds are drawn up front so results don't depend on thread scheduling
+  rng_t *rng = rng_init(seed);
+  for (size_t i = 0; i < runs; i++) {
+    out->seeds[i] = rng_next(rng);
+  }
+  rng_free(rng);
+  atomic_init(&out->next_run, 0);
+  out->wall_seconds = 0;
+  return out;
+}
+
+void batch_free(batch_t *batch) {
+  free(batch->seeds);
+  free(batch->results);
+  free(batch);
+}
+
+// plays one game with a random-walk player: hold a random direction, switch
+// after an exponentially distributed delay
+run_result_t batch_play(uint64_t seed, double seconds) {
+  const char directions[] = {W_KEY, A_KEY, S_KEY, D_KEY};
+  rng_t *policy = rng_init(seed ^ 0x5bd1e995);
+  state_t *state = game_init(seed);
+  run_result_t result = {.frames = 0};
+  double next_turn = 0;
+  while (!game_is_over(state) && game_get_time(state) < seconds) {
+    if (game_get_time(state) >= next_turn) {
+      game_key(state, directions[rng_range(policy, 4)], KEY_PRESSED);
+      next_turn += -log(1 - rng_double(policy)) * POLICY_INTERVAL;
+    }
+    game_step(state, BATCH_FRAME_STEP);
+    result.frames++;
+  }
+  result.finished = game_is_over(state);
+  result.won = game_is_won(state);
+  result.survived = game_get_time(state);
+  result.coins = game_get_coins(state);
+  game_free(state);
+  rng_free(policy);
+  return result;
+}
+
+void *batch_worker(void *aux) {
+  batch_t *batch = (batch_t *)aux;
+  while (true) {
+    size_t run = atomic_fetch_add(&batch->next_run, 1);
+    if (run >= batch->runs) {
+      return NULL;
+    }
+    batch->results[run] = batch_play(batch->seeds[run], batch->seconds);
+  }
+}
+
+double batch_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void batch_run(batch_t *batch) {
+  double start = batch_clock();
+  atomic_store(&batch->next_run, 0);
+  pthread_t *workers = malloc(sizeof(pthread_t) * batch->threads);
+  assert(workers != NULL);
+  for (size_t i = 0; i < batch->threads; i++) {
+    int error = pthread_create(&workers[i], NULL, batch_worker, batch);
+    assert(error == 0);
+  }
+  for (size_t i = 0; i < batch->threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  batch->wall_seconds = batch_clock() - start;
+}
+
+size_t batch_wins(batch_t *batch) {
+  size_t wins = 0;
+  for (size_t i = 0; i < batch->runs; i++) {
+    wins += batch->results[i].won;
+  }
+  return wins;
+}
+
+size_t batch_losses(batch_t *batch) {
+  size_t losses = 0;
+  for (size_t i = 0; i < batch->runs; i++) {
+    losses += batch->results[i].finished && !batch->results[i].won;
+  }
+  return losses;
+}
+
+double batch_mean_coins(batch_t *batch) {
+  double total = 0;
+  for (size_t i = 0; i < batch->runs; i++) {
+    total += batch->results[i].coins;
+  }
+  return total / batch->runs;
+}
+
+double batch_mean_survival(batch_t *batch) {
+  double total = 0;
+  for (size_t i = 0; i < batch->runs; i++) {
+    total += batch->results[i].survived;
+  }
+  return total / batch->runs;
+}
+
+double batch_frames_per_second(batch_t *batch) {
+  double frames = 0;
+  for (size_t i = 0; i < batch->runs; i++) {
+    frames += batch->results[i].frames;
+  }
+  return batch->wall_seconds > 0 ? frames / batch->wall_seconds : 0;
+}
+
+void batch_print(batch_t *batch, FILE *out) {
+  fprintf(out,
+          "runs %zu threads %zu wins %zu losses %zu unfinished %zu\n"
+          "mean coins %.2f mean survival %.2fs\n"
+          "wall %.3fs (%.0f frames/s)\n",
+          batch->runs, batch->threads, batch_wins(batch),
+          batch_losses(batch),
+          batch->runs - batch_wins(batch) - batch_losses(batch),
+          batch_mean_coins(batch), batch_mean_survival(batch),
+          batch->wall_seconds, batch_frames_per_second(batch));
+}
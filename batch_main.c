@@ -0,0 +1,38 @@
+#include "batch.h"
+#include "texture.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Monte Carlo driver for batch.c; link with headless_wrapper.c.
+// usage: batch [--runs N] [--threads T] [--seconds S] [--seed X]
+
+int main(int argc, char *argv[]) {
+  size_t runs = 1000;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t threads = cores > 0 ? (size_t)cores : 1;
+  double seconds = 30;
+  uint64_t seed = 3;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--runs") == 0) {
+      runs = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      threads = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--seconds") == 0) {
+      seconds = atof(argv[i + 1]);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = strtoull(argv[i + 1], NULL, 10);
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  batch_t *batch = batch_init(runs, threads, seconds, seed);
+  batch_run(batch);
+  batch_print(batch, stdout);
+  batch_free(batch);
+  texture_registry_free();
+  return 0;
+}
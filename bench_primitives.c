@@ -0,0 +1,397 @@
+#include "alloc.h"
+#include "collision.h"
+#include "gen_list.h"
+#include "list.h"
+#include "polygon.h"
+#include "vector.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Microbenchmarks for the list, vector, polygon and collision primitives.
+// Each benchmark times reps repetitions of ops operations, after warmup
+// untimed repetitions, and reports the median and p99 time per operation.
+// Anything a benchmark consumes, like the shapes find_collision frees, is
+// built outside the timed region.
+// usage: bench_primitives [--reps N] [--warmup N] [--filter TEXT]
+//                         [--json FILE]
+
+const size_t DEFAULT_REPS = 200;
+const size_t DEFAULT_WARMUP = 20;
+const size_t LIST_OPS = 1024;
+const size_t VECTOR_OPS = 4096;
+const size_t POLYGON_OPS = 256;
+const size_t COLLISION_OPS = 64;
+const double POLYGON_RADIUS = 50;
+// separated shapes are far enough apart that no axis overlaps
+const double SEPARATED_OFFSET = 500;
+
+typedef struct bench_state {
+  size_t ops;
+  size_t sides;
+  double offset;
+  list_t *list;
+  gen_list_t *gen_list;
+  vector_t *vectors;
+  list_t **shapes;
+  size_t *items;
+} bench_state_t;
+
+typedef struct benchmark {
+  const char *name;
+  size_t ops;
+  size_t sides;
+  double offset;
+  // setup and teardown run around every repetition and aren't timed
+  void (*setup)(bench_state_t *state);
+  void (*run)(bench_state_t *state);
+  void (*teardown)(bench_state_t *state);
+} benchmark_t;
+
+typedef struct bench_result {
+  const char *name;
+  size_t ops;
+  double median;
+  double p99;
+  double min;
+} bench_result_t;
+
+// results are folded in here so the compiler can't drop the work
+volatile double sink = 0;
+
+double bench_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int bench_compare_doubles(const void *a, const void *b) {
+  double first = *(const double *)a;
+  double second = *(const double *)b;
+  return first < second ? -1 : first > second;
+}
+
+list_t *regular_polygon(size_t sides, vector_t center) {
+  list_t *out = list_init(sides, free);
+  for (size_t i = 0; i < sides; i++) {
+    double angle = 2 * M_PI * i / sides;
+    vector_t *vertex = malloc(sizeof(vector_t));
+    assert(vertex != NULL);
+    *vertex = (vector_t){.x = center.x + POLYGON_RADIUS * cos(angle),
+                         .y = center.y + POLYGON_RADIUS * sin(angle)};
+    list_add(out, vertex);
+  }
+  return out;
+}
+
+// list items are addresses into a plain array so nothing is freed per item
+void items_setup(bench_state_t *state) {
+  state->items = malloc(sizeof(size_t) * state->ops);
+  assert(state->items != NULL);
+  state->list = list_init(state->ops, NULL);
+  for (size_t i = 0; i < state->ops; i++) {
+    list_add(state->list, &state->items[i]);
+  }
+}
+
+void items_teardown(bench_state_t *state) {
+  list_free(state->list);
+  free(state->items);
+}
+
+void empty_list_setup(bench_state_t *state) {
+  state->items = malloc(sizeof(size_t) * state->ops);
+  assert(state->items != NULL);
+  state->list = list_init(1, NULL);
+}
+
+void run_list_add(bench_state_t *state) {
+  for (size_t i = 0; i < state->ops; i++) {
+    list_add(state->list, &state->items[i]);
+  }
+}
+
+void run_list_remove_back(bench_state_t *state) {
+  for (size_t i = 0; i < state->ops; i++) {
+    list_remove(state->list, list_size(state->list) - 1);
+  }
+}
+
+// removing the front shifts the whole list every time
+void run_list_remove_front(bench_state_t *state) {
+  for (size_t i = 0; i < state->ops; i++) {
+    list_remove(state->list, 0);
+  }
+}
+
+// looks up every item, so each find scans half the list on average
+void run_list_find(bench_state_t *state) {
+  size_t total = 0;
+  for (size_t i = 0; i < state->ops; i++) {
+    total += list_find(state->list, &state->items[i]);
+  }
+  sink += total;
+}
+
+void gen_list_setup(bench_state_t *state) {
+  state->items = malloc(sizeof(size_t) * state->ops);
+  assert(state->items != NULL);
+  state->gen_list = gen_list_init(1);
+}
+
+void no_free(void *item) {}
+
+void gen_list_teardown(bench_state_t *state) {
+  gen_list_free(state->gen_list, no_free);
+  free(state->items);
+}
+
+void run_gen_list_add_back(bench_state_t *state) {
+  for (size_t i = 0; i < state->ops; i++) {
+    gen_list_add_back(state->gen_list, &state->items[i]);
+  }
+}
+
+void run_gen_list_add_remove(bench_state_t *state) {
+  for (size_t i = 0; i < state->ops; i++) {
+    gen_list_add_back(state->gen_list, &state->items[i]);
+  }
+  for (size_t i = 0; i < state->ops; i++) {
+    gen_list_remove_back(state->gen_list);
+  }
+}
+
+void vectors_setup(bench_state_t *state) {
+  state->vectors = malloc(sizeof(vector_t) * state->ops);
+  assert(state->vectors != NULL);
+  for (size_t i = 0; i < state->ops; i++) {
+    state->vectors[i] = (vector_t){.x = i * 0.5, .y = 1.0 - i * 0.25};
+  }
+}
+
+void vectors_teardown(bench_state_t *state) { free(state->vectors); }
+
+void run_vec_add(bench_state_t *state) {
+  vector_t total = VEC_ZERO;
+  for (size_t i = 0; i < state->ops; i++) {
+    total = vec_add(total, state->vectors[i]);
+  }
+  sink += total.x + total.y;
+}
+
+void run_vec_dot_cross(bench_state_t *state) {
+  double total = 0;
+  for (size_t i = 1; i < state->ops; i++) {
+    total += vec_dot(state->vectors[i - 1], state->vectors[i]) +
+             vec_cross(state->vectors[i - 1], state->vectors[i]);
+  }
+  sink += total;
+}
+
+void run_vec_rotate(bench_state_t *state) {
+  double total = 0;
+  for (size_t i = 0; i < state->ops; i++) {
+    vector_t rotated = vec_rotate(state->vectors[i], 0.1 * i);
+    total += rotated.x;
+  }
+  sink += total;
+}
+
+void polygon_setup(bench_state_t *state) {
+  state->list = regular_polygon(state->sides, (vector_t){.x = 0, .y = 0});
+}
+
+void polygon_teardown(bench_state_t *state) { list_free(state->list); }
+
+void run_polygon_area(bench_state_t *state) {
+  double total = 0;
+  for (size_t i = 0; i < state->ops; i++) {
+    total += polygon_area(state->list);
+  }
+  sink += total;
+}
+
+void run_polygon_centroid(bench_state_t *state) {
+  double total = 0;
+  for (size_t i = 0; i < state->ops; i++) {
+    total += polygon_centroid(state->list).x;
+  }
+  sink += total;
+}
+
+void run_polygon_rotate(bench_state_t *state) {
+  vector_t center = (vector_t){.x = 0, .y = 0};
+  for (size_t i = 0; i < state->ops; i++) {
+    polygon_rotate((gen_list_t *)state->list, 0.01, center);
+  }
+}
+
+// find_collision frees both shapes, so every call gets its own pair
+void collision_setup(bench_state_t *state) {
+  state->shapes = malloc(sizeof(list_t *) * state->ops * 2);
+  assert(state->shapes != NULL);
+  vector_t origin = (vector_t){.x = 0, .y = 0};
+  vector_t other = (vector_t){.x = state->offset, .y = 0};
+  for (size_t i = 0; i < state->ops; i++) {
+    state->shapes[2 * i] = regular_polygon(state->sides, origin);
+    state->shapes[2 * i + 1] = regular_polygon(state->sides, other);
+  }
+}
+
+void collision_teardown(bench_state_t *state) { free(state->shapes); }
+
+void run_find_collision(bench_state_t *state) {
+  size_t collided = 0;
+  for (size_t i = 0; i < state->ops; i++) {
+    collision_info_t *collision =
+        find_collision(state->shapes[2 * i], state->shapes[2 * i + 1]);
+    collided += collision->collided;
+    tracked_free(collision);
+  }
+  sink += collided;
+}
+
+#define COLLISION_BENCHMARK(sides, offset, name)                              \
+  {name, COLLISION_OPS, sides, offset,                                        \
+   collision_setup, run_find_collision, collision_teardown}
+#define POLYGON_BENCHMARKS(sides)                                             \
+  {"polygon_area/" #sides, POLYGON_OPS, sides, 0,                             \
+   polygon_setup, run_polygon_area, polygon_teardown},                        \
+  {"polygon_centroid/" #sides, POLYGON_OPS, sides, 0,                         \
+   polygon_setup, run_polygon_centroid, polygon_teardown},                    \
+  {"polygon_rotate/" #sides, POLYGON_OPS, sides, 0,                           \
+   polygon_setup, run_polygon_rotate, polygon_teardown}
+
+const benchmark_t BENCHMARKS[] = {
+    {"list_add", LIST_OPS, 0, 0, empty_list_setup, run_list_add,
+     items_teardown},
+    {"list_remove_back", LIST_OPS, 0, 0, items_setup, run_list_remove_back,
+     items_teardown},
+    {"list_remove_front", LIST_OPS, 0, 0, items_setup, run_list_remove_front,
+     items_teardown},
+    {"list_find", LIST_OPS, 0, 0, items_setup, run_list_find,
+     items_teardown},
+    {"gen_list_add_back", LIST_OPS, 0, 0, gen_list_setup,
+     run_gen_list_add_back, gen_list_teardown},
+    {"gen_list_add_remove", LIST_OPS, 0, 0, gen_list_setup,
+     run_gen_list_add_remove, gen_list_teardown},
+    {"vec_add", VECTOR_OPS, 0, 0, vectors_setup, run_vec_add,
+     vectors_teardown},
+    {"vec_dot_cross", VECTOR_OPS, 0, 0, vectors_setup, run_vec_dot_cross,
+     vectors_teardown},
+    {"vec_rotate", VECTOR_OPS, 0, 0, vectors_setup, run_vec_rotate,
+     vectors_teardown},
+    POLYGON_BENCHMARKS(4),
+    POLYGON_BENCHMARKS(16),
+    POLYGON_BENCHMARKS(100),
+    COLLISION_BENCHMARK(4, POLYGON_RADIUS, "find_collision/4/overlapping"),
+    COLLISION_BENCHMARK(4, SEPARATED_OFFSET, "find_collision/4/separated"),
+    COLLISION_BENCHMARK(16, POLYGON_RADIUS, "find_collision/16/overlapping"),
+    COLLISION_BENCHMARK(16, SEPARATED_OFFSET, "find_collision/16/separated"),
+    COLLISION_BENCHMARK(100, POLYGON_RADIUS,
+                        "find_collision/100/overlapping"),
+    COLLISION_BENCHMARK(100, SEPARATED_OFFSET,
+                        "find_collision/100/separated"),
+};
+
+bench_result_t run_benchmark(const benchmark_t *benchmark, size_t reps,
+                             size_t warmup, double *samples) {
+  bench_state_t state = {.ops = benchmark->ops,
+                         .sides = benchmark->sides,
+                         .offset = benchmark->offset};
+  for (size_t r = 0; r < warmup + reps; r++) {
+    benchmark->setup(&state);
+    double start = bench_now();
+    benchmark->run(&state);
+    double elapsed = bench_now() - start;
+    benchmark->teardown(&state);
+    if (r >= warmup) {
+      samples[r - warmup] = elapsed / benchmark->ops * 1e9;
+    }
+  }
+  qsort(samples, reps, sizeof(double), bench_compare_doubles);
+  return (bench_result_t){.name = benchmark->name,
+                          .ops = benchmark->ops,
+                          .median = samples[reps / 2],
+                          .p99 = samples[(size_t)(0.99 * (reps - 1) + 0.5)],
+                          .min = samples[0]};
+}
+
+void bench_write_json(FILE *out, bench_result_t *results, size_t count,
+                      size_t reps, size_t warmup) {
+  fprintf(out, "{\"reps\": %zu, \"warmup\": %zu, \"unit\": \"ns/op\", "
+               "\"benchmarks\": [\n", reps, warmup);
+  for (size_t i = 0; i < count; i++) {
+    fprintf(out,
+            "  {\"name\": \"%s\", \"ops\": %zu, \"median\": %.3f, "
+            "\"p99\": %.3f, \"min\": %.3f}%s\n",
+            results[i].name, results[i].ops, results[i].median,
+            results[i].p99, results[i].min, i + 1 < count ? "," : "");
+  }
+  fprintf(out, "]}\n");
+}
+
+int main(int argc, char *argv[]) {
+  size_t reps = DEFAULT_REPS;
+  size_t warmup = DEFAULT_WARMUP;
+  const char *filter = NULL;
+  const char *json = NULL;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--reps") == 0) {
+      reps = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--warmup") == 0) {
+      warmup = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--filter") == 0) {
+      filter = argv[i + 1];
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = argv[i + 1];
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (reps == 0) {
+    fprintf(stderr, "--reps must be positive\n");
+    return 1;
+  }
+
+  size_t count = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+  bench_result_t *results = malloc(sizeof(bench_result_t) * count);
+  double *samples = malloc(sizeof(double) * reps);
+  assert(results != NULL);
+  assert(samples != NULL);
+  size_t ran = 0;
+  printf("%-32s %8s %12s %12s %12s\n", "benchmark", "ops", "median ns",
+         "p99 ns", "min ns");
+  for (size_t i = 0; i < count; i++) {
+    if (filter != NULL && strstr(BENCHMARKS[i].name, filter) == NULL) {
+      continue;
+    }
+    bench_result_t result =
+        run_benchmark(&BENCHMARKS[i], reps, warmup, samples);
+    printf("%-32s %8zu %12.2f %12.2f %12.2f\n", result.name, result.ops,
+           result.median, result.p99, result.min);
+    results[ran++] = result;
+  }
+
+  int status = 0;
+  if (json != NULL) {
+    FILE *out = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+    if (out == NULL) {
+      fprintf(stderr, "couldn't write %s\n", json);
+      status = 1;
+    } else {
+      bench_write_json(out, results, ran, reps, warmup);
+      if (out != stdout) {
+        fclose(out);
+      }
+    }
+  }
+  free(samples);
+  free(results);
+  return status;
+}
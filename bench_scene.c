@@ -0,0 +1,309 @@
+#include "body.h"
+#include "color.h"
+#include "forces.h"
+#include "geometry.h"
+#include "rng.h"
+#include "scene.h"
+#include "vector.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Scene scaling benchmark. Builds synthetic scenes through the public scene
+// and force APIs, sweeping the body count by powers of ten and the number of
+// forces per body, and reports the cost of scene_tick per body per tick.
+// Results can be saved as JSON and compared against a saved baseline, failing
+// when any workload got slower than the threshold allows.
+// usage: bench_scene [--max-bodies N] [--steps N] [--warmup N]
+//                    [--workload NAME] [--json FILE] [--baseline FILE]
+//                    [--threshold FRACTION]
+
+const size_t MIN_BODIES = 10;
+const size_t DEFAULT_MAX_BODIES = 100000;
+const size_t DEFAULT_STEPS = 20;
+const size_t DEFAULT_WARMUP = 2;
+// 15% slower than the baseline is a regression
+const double DEFAULT_THRESHOLD = 0.15;
+const double BENCH_STEP = 1.0 / 120;
+const uint64_t BENCH_SEED = 3;
+// bodies are squares on a grid, close enough that neighbours sometimes touch
+const double BODY_SIZE = 10;
+const double BODY_SPACING = 12;
+const double BODY_MASS = 1;
+const double BODY_SPEED = 40;
+const double DRAG = 0.1;
+const double GRAVITY = 100;
+const double ELASTICITY = 0.8;
+const rgb_color_t BODY_COLOR = {.r = 0.5, .g = 0.5, .b = 0.5};
+
+typedef enum workload_kind {
+  // no forces; just integration and the broadphase tree
+  FREE_WORKLOAD,
+  DRAG_WORKLOAD,
+  GRAVITY_WORKLOAD,
+  COLLISION_WORKLOAD
+} workload_kind_t;
+
+typedef struct workload {
+  const char *name;
+  workload_kind_t kind;
+  // forces per body; pair forces go to the next density bodies on the grid
+  size_t density;
+} workload_t;
+
+const workload_t WORKLOADS[] = {
+    {"free", FREE_WORKLOAD, 0},
+    {"drag", DRAG_WORKLOAD, 1},
+    {"gravity/1", GRAVITY_WORKLOAD, 1},
+    {"gravity/4", GRAVITY_WORKLOAD, 4},
+    {"collision/1", COLLISION_WORKLOAD, 1},
+    {"collision/4", COLLISION_WORKLOAD, 4},
+};
+
+typedef struct scene_result {
+  char name[64];
+  size_t bodies;
+  size_t forces;
+  double ns_per_body_tick;
+  double build_seconds;
+} scene_result_t;
+
+double now_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+geometry_t *square_geometry(void) {
+  double half = BODY_SIZE / 2;
+  vector_t corners[] = {{.x = -half, .y = -half},
+                        {.x = half, .y = -half},
+                        {.x = half, .y = half},
+                        {.x = -half, .y = half}};
+  return geometry_init_local(corners, 4);
+}
+
+scene_t *build_scene(const workload_t *workload, size_t bodies,
+                     geometry_t *geometry) {
+  scene_t *scene = scene_init();
+  scene_seed(scene, BENCH_SEED);
+  rng_t *rng = scene_get_rng(scene);
+  size_t columns = (size_t)ceil(sqrt(bodies));
+  for (size_t i = 0; i < bodies; i++) {
+    body_t *body = body_init_with_geometry(geometry, BODY_MASS, BODY_COLOR,
+                                           NULL, NULL, NULL);
+    body_set_centroid(body, (vector_t){.x = (i % columns) * BODY_SPACING,
+                                       .y = (i / columns) * BODY_SPACING});
+    double angle = 2 * M_PI * rng_double(rng);
+    body_set_velocity(body, vec_rotate((vector_t){.x = BODY_SPEED, .y = 0},
+                                       angle));
+    scene_add_body(scene, body);
+  }
+  for (size_t i = 0; i < bodies; i++) {
+    body_t *body = scene_get_body(scene, i);
+    if (workload->kind == DRAG_WORKLOAD) {
+      create_drag(scene, DRAG, body);
+      continue;
+    }
+    for (size_t d = 1; d <= workload->density && i + d < bodies; d++) {
+      body_t *other = scene_get_body(scene, i + d);
+      if (workload->kind == GRAVITY_WORKLOAD) {
+        create_newtonian_gravity(scene, GRAVITY, body, other);
+      } else if (workload->kind == COLLISION_WORKLOAD) {
+        create_physics_collision(scene, ELASTICITY, body, other);
+      }
+    }
+  }
+  return scene;
+}
+
+scene_result_t run_workload(const workload_t *workload, size_t bodies,
+                            size_t steps, size_t warmup,
+                            geometry_t *geometry) {
+  double start = now_seconds();
+  scene_t *scene = build_scene(workload, bodies, geometry);
+  double built = now_seconds();
+  for (size_t i = 0; i < warmup; i++) {
+    scene_tick(scene, BENCH_STEP);
+  }
+  double ticking = now_seconds();
+  for (size_t i = 0; i < steps; i++) {
+    scene_tick(scene, BENCH_STEP);
+  }
+  double elapsed = now_seconds() - ticking;
+  scene_result_t out = {.bodies = bodies,
+                        .forces = scene_forces(scene),
+                        .ns_per_body_tick = elapsed / steps / bodies * 1e9,
+                        .build_seconds = built - start};
+  snprintf(out.name, sizeof(out.name), "%s/%zu", workload->name, bodies);
+  scene_free(scene);
+  return out;
+}
+
+void write_json(FILE *out, scene_result_t *results, size_t count,
+                size_t steps) {
+  fprintf(out, "{\"steps\": %zu, \"unit\": \"ns/body/tick\", \"results\": [\n",
+          steps);
+  for (size_t i = 0; i < count; i++) {
+    fprintf(out,
+            "  {\"name\": \"%s\", \"bodies\": %zu, \"forces\": %zu, "
+            "\"ns_per_body_tick\": %.3f}%s\n",
+            results[i].name, results[i].bodies, results[i].forces,
+            results[i].ns_per_body_tick, i + 1 < count ? "," : "");
+  }
+  fprintf(out, "]}\n");
+}
+
+// reads back the "name" and "ns_per_body_tick" pairs write_json produces;
+// returns a negative time for workloads the baseline doesn't have
+double baseline_lookup(const char *baseline, const char *name) {
+  char key[96];
+  snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+  const char *entry = strstr(baseline, key);
+  if (entry == NULL) {
+    return -1;
+  }
+  const char *value = strstr(entry, "\"ns_per_body_tick\": ");
+  if (value == NULL) {
+    return -1;
+  }
+  return strtod(value + strlen("\"ns_per_body_tick\": "), NULL);
+}
+
+char *read_file(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *out = malloc(size + 1);
+  assert(out != NULL);
+  size_t read = fread(out, 1, size, file);
+  out[read] = '\0';
+  fclose(file);
+  return out;
+}
+
+// prints every workload against the baseline; returns how many regressed
+size_t compare_baseline(const char *baseline, scene_result_t *results,
+                        size_t count, double threshold) {
+  size_t regressions = 0;
+  printf("\n%-24s %12s %12s %9s\n", "workload", "baseline", "current",
+         "change");
+  for (size_t i = 0; i < count; i++) {
+    double before = baseline_lookup(baseline, results[i].name);
+    if (before <= 0) {
+      printf("%-24s %12s %12.2f %9s\n", results[i].name, "-",
+             results[i].ns_per_body_tick, "new");
+      continue;
+    }
+    double change = results[i].ns_per_body_tick / before - 1;
+    bool regressed = change > threshold;
+    regressions += regressed;
+    printf("%-24s %12.2f %12.2f %+8.1f%%%s\n", results[i].name, before,
+           results[i].ns_per_body_tick, change * 100,
+           regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_bodies = DEFAULT_MAX_BODIES;
+  size_t steps = DEFAULT_STEPS;
+  size_t warmup = DEFAULT_WARMUP;
+  double threshold = DEFAULT_THRESHOLD;
+  const char *only = NULL;
+  const char *json = NULL;
+  const char *baseline_path = NULL;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--max-bodies") == 0) {
+      max_bodies = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--steps") == 0) {
+      steps = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--warmup") == 0) {
+      warmup = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--workload") == 0) {
+      only = argv[i + 1];
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = argv[i + 1];
+    } else if (strcmp(argv[i], "--baseline") == 0) {
+      baseline_path = argv[i + 1];
+    } else if (strcmp(argv[i], "--threshold") == 0) {
+      threshold = atof(argv[i + 1]);
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (steps == 0) {
+    fprintf(stderr, "--steps must be positive\n");
+    return 1;
+  }
+  char *baseline = NULL;
+  if (baseline_path != NULL) {
+    baseline = read_file(baseline_path);
+    if (baseline == NULL) {
+      fprintf(stderr, "couldn't read baseline %s\n", baseline_path);
+      return 1;
+    }
+  }
+
+  size_t workloads = sizeof(WORKLOADS) / sizeof(WORKLOADS[0]);
+  size_t capacity = workloads * 8;
+  scene_result_t *results = malloc(sizeof(scene_result_t) * capacity);
+  assert(results != NULL);
+  size_t count = 0;
+  geometry_t *geometry = square_geometry();
+  printf("%-24s %8s %8s %14s %10s\n", "workload", "bodies", "forces",
+         "ns/body/tick", "build s");
+  for (size_t w = 0; w < workloads; w++) {
+    if (only != NULL && strcmp(WORKLOADS[w].name, only) != 0) {
+      continue;
+    }
+    for (size_t bodies = MIN_BODIES; bodies <= max_bodies; bodies *= 10) {
+      if (count == capacity) {
+        capacity *= 2;
+        results = realloc(results, sizeof(scene_result_t) * capacity);
+        assert(results != NULL);
+      }
+      scene_result_t result =
+          run_workload(&WORKLOADS[w], bodies, steps, warmup, geometry);
+      printf("%-24s %8zu %8zu %14.2f %10.3f\n", result.name, result.bodies,
+             result.forces, result.ns_per_body_tick, result.build_seconds);
+      fflush(stdout);
+      results[count++] = result;
+    }
+  }
+  geometry_release(geometry);
+
+  int status = 0;
+  if (json != NULL) {
+    FILE *out = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+    if (out == NULL) {
+      fprintf(stderr, "couldn't write %s\n", json);
+      status = 1;
+    } else {
+      write_json(out, results, count, steps);
+      if (out != stdout) {
+        fclose(out);
+      }
+    }
+  }
+  if (baseline != NULL) {
+    size_t regressions = compare_baseline(baseline, results, count, threshold);
+    if (regressions > 0) {
+      printf("%zu workloads regressed more than %.0f%%\n", regressions,
+             threshold * 100);
+      status = 1;
+    }
+    free(baseline);
+  }
+  free(results);
+  return status;
+}
@@ -1,11 +1,15 @@
 #include "body.h"
+#include "alloc.h"
 #include "assert.h"
+#include "geometry.h"
 #include "list.h"
 #include "polygon.h"
+#include "texture.h"
+#include <math.h>
 #include <stdlib.h>
 
 typedef struct body {
-  list_t *shape;
+  geometry_t *geometry;
   double mass;
   size_t coins;
   rgb_color_t color;
@@ -18,69 +22,139 @@ typedef struct body {
   void *info;
   free_func_t info_freer;
   char *texture_link;
+  // texture_link interned and the size it's drawn at, so renderers neither
+  // compare strings nor lock the texture registry per frame
+  size_t texture_id;
+  vector_t texture_size;
+  body_recycler_t recycler;
+  void *recycler_aux;
 } body_t;
 
 void info_freer(void *info) { free(info); }
 
-body_t *body_init(list_t *shape, double mass, rgb_color_t color, char* link) {
-  body_t *out = malloc(sizeof(body_t));
+// sizes are read when the texture is set, so register them before bodies
+// use them
+void body_intern_texture(body_t *body, char *link) {
+  body->texture_link = link;
+  body->texture_id = texture_intern(link);
+  body->texture_size = body->texture_id != NO_TEXTURE
+                           ? texture_get_size(body->texture_id)
+                           : VEC_ZERO;
+}
+
+body_t *body_init_with_geometry(geometry_t *geometry, double mass,
+                                rgb_color_t color, void *info,
+                                free_func_t info_freer2, char *link) {
+  body_t *out = tracked_malloc(sizeof(body_t), ALLOC_BODY);
   assert(out != NULL);
-  out->shape = shape;
+  out->geometry = geometry_retain(geometry);
   out->mass = mass;
-  out->coins = 0;
   out->color = color;
-  out->velocity = (vector_t){.x = 0, .y = 0};
-  out->angle = 0;
-  out->centroid = polygon_centroid(shape);
-  out->f = (vector_t){.x = 0, .y = 0};
-  out->i = (vector_t){.x = 0, .y = 0};
-  out->status = false;
-  out->info = NULL;
-  out->info_freer = NULL;
-  out->texture_link = link;
+  out->centroid = (vector_t){.x = 0, .y = 0};
+  out->info = info;
+  out->info_freer = info_freer2;
+  body_intern_texture(out, link);
+  out->recycler = NULL;
+  out->recycler_aux = NULL;
+  body_reset(out, out->centroid);
   return out;
 }
 
+// shapes handed to body_init are owned by the body, so the world-space list
+// is folded into private local-space geometry and freed right away
+body_t *body_init(list_t *shape, double mass, rgb_color_t color, char* link) {
+  return body_init_with_info(shape, mass, color, NULL, NULL, link);
+}
+
 body_t *body_init_with_info(list_t *shape, double mass, rgb_color_t color,
                             void *info, free_func_t info_freer2, char* link) {
-  body_t *out = malloc(sizeof(body_t));
-  assert(out != NULL);
-  out->shape = shape;
-  out->mass = mass;
-  out->coins = 0;
-  out->color = color;
-  out->centroid = polygon_centroid(shape);
-  out->velocity = (vector_t){.x = 0, .y = 0};
-  out->angle = 0;
-  out->f = (vector_t){.x = 0, .y = 0};
-  out->i = (vector_t){.x = 0, .y = 0};
-  out->status = false;
-  out->info = info;
-  out->info_freer = info_freer2;
-  out->texture_link = link;
+  vector_t centroid = polygon_centroid(shape);
+  geometry_t *geometry = geometry_init(shape, centroid);
+  list_free(shape);
+  body_t *out =
+      body_init_with_geometry(geometry, mass, color, info, info_freer2, link);
+  geometry_release(geometry);
+  out->centroid = centroid;
   return out;
 }
 
+void body_reset(body_t *body, vector_t centroid) {
+  body->coins = 0;
+  body->centroid = centroid;
+  body->velocity = (vector_t){.x = 0, .y = 0};
+  body->angle = 0;
+  body->f = (vector_t){.x = 0, .y = 0};
+  body->i = (vector_t){.x = 0, .y = 0};
+  body->status = false;
+}
+
+void body_set_recycler(body_t *body, body_recycler_t recycler, void *aux) {
+  body->recycler = recycler;
+  body->recycler_aux = aux;
+}
+
 void body_free(body_t *body) {
-  list_free(body->shape);
+  if (body->recycler != NULL) {
+    body->recycler(body, body->recycler_aux);
+    return;
+  }
+  geometry_release(body->geometry);
   if (body->info_freer != NULL && body->info != NULL) {
     body->info_freer(body->info);
   }
-  free(body);
+  tracked_free(body);
 }
 
+geometry_t *body_get_geometry(body_t *body) { return body->geometry; }
+
 list_t *body_get_shape(body_t *body) {
-  list_t *out = list_init(list_size(body->shape), (free_func_t)free);
-  for (size_t i = 0; i < list_size(body->shape); i++) {
-    vector_t *original = list_get(body->shape, i);
-    vector_t *copy = malloc(sizeof(vector_t));
-    copy->x = original->x;
-    copy->y = original->y;
+  size_t size = geometry_size(body->geometry);
+  const vector_t *vertices = geometry_get_vertices(body->geometry);
+  list_t *out = list_init(size, tracked_free);
+  for (size_t i = 0; i < size; i++) {
+    vector_t *copy = tracked_malloc(sizeof(vector_t), ALLOC_BODY);
+    vector_t local =
+        body->angle == 0 ? vertices[i] : vec_rotate(vertices[i], body->angle);
+    *copy = vec_add(body->centroid, local);
     list_add(out, copy);
   }
   return out;
 }
 
+size_t body_vertex_count(body_t *body) {
+  return geometry_size(body->geometry);
+}
+
+// writes the world-space vertices into out without allocating; out needs
+// room for body_vertex_count(body) of them
+void body_get_vertices(body_t *body, vector_t *out) {
+  size_t size = geometry_size(body->geometry);
+  const vector_t *vertices = geometry_get_vertices(body->geometry);
+  for (size_t i = 0; i < size; i++) {
+    vector_t local =
+        body->angle == 0 ? vertices[i] : vec_rotate(vertices[i], body->angle);
+    out[i] = vec_add(body->centroid, local);
+  }
+}
+
+void body_get_bounds(body_t *body, vector_t *min, vector_t *max) {
+  if (body->angle == 0) {
+    *min = vec_add(body->centroid, geometry_get_min(body->geometry));
+    *max = vec_add(body->centroid, geometry_get_max(body->geometry));
+    return;
+  }
+  const vector_t *vertices = geometry_get_vertices(body->geometry);
+  *min = vec_add(body->centroid, vec_rotate(vertices[0], body->angle));
+  *max = *min;
+  for (size_t i = 1; i < geometry_size(body->geometry); i++) {
+    vector_t point = vec_add(body->centroid, vec_rotate(vertices[i], body->angle));
+    min->x = fmin(min->x, point.x);
+    min->y = fmin(min->y, point.y);
+    max->x = fmax(max->x, point.x);
+    max->y = fmax(max->y, point.y);
+  }
+}
+
 vector_t body_get_centroid(body_t *body) { return body->centroid; }
 
 size_t body_get_coins(body_t *body) { return body->coins; }
@@ -97,32 +171,36 @@ void body_set_color(body_t *body, rgb_color_t color) {
 
 void *body_get_info(body_t *body) { return body->info; }
 
-void body_set_centroid(body_t *body, vector_t x) {
-  for (size_t i = 0; i < list_size(body->shape); i++) {
-    vector_t *point = list_get(body->shape, i);
-    *point = vec_add(x, vec_subtract(*point, body->centroid));
-  }
-  body->centroid = x;
-}
+void body_set_centroid(body_t *body, vector_t x) { body->centroid = x; }
+
+double body_get_angle(body_t *body) { return body->angle; }
+
+vector_t body_get_force(body_t *body) { return body->f; }
+
+vector_t body_get_impulse(body_t *body) { return body->i; }
 
 char* body_get_texture(body_t *body) {
   return body->texture_link;
 }
 
 void body_set_texture(body_t *body, char *link) {
-  body->texture_link = link;
+  body_intern_texture(body, link);
 }
+
+size_t body_get_texture_id(body_t *body) { return body->texture_id; }
+
+vector_t body_get_texture_size(body_t *body) { return body->texture_size; }
+
 void body_set_coins(body_t * body) {
   size_t new_coins = body->coins + 1;
   body->coins = new_coins;
 }
 
+void body_set_coin_count(body_t *body, size_t coins) { body->coins = coins; }
+
 void body_set_velocity(body_t *body, vector_t v) { body->velocity = v; }
 
-void body_set_rotation(body_t *body, double angle) {
-  polygon_rotate(body->shape, angle - body->angle, body->centroid);
-  body->angle = angle;
-}
+void body_set_rotation(body_t *body, double angle) { body->angle = angle; }
 
 void body_add_force(body_t *body, vector_t force) {
   vector_t forc = vec_add(body->f, force);
@@ -1,5 +1,7 @@
 #include "collision.h"
+#include "alloc.h"
 #include "list.h"
+#include "profiler.h"
 #include "vector.h"
 #include <math.h>
 #include <stdbool.h>
@@ -8,14 +10,14 @@
 bool collision_checker(list_t *shape1, list_t *shape2) {
   collision_info_t *collision = find_collision(shape1, shape2);
   bool truth = collision->collided;
-  free(collision);
+  tracked_free(collision);
   return truth;
 }
 
 vector_t collision_vec(list_t *shape1, list_t *shape2) {
   collision_info_t *collision = find_collision(shape1, shape2);
   vector_t ax = collision->axis;
-  free(collision);
+  tracked_free(collision);
   return ax;
 }
 
@@ -24,7 +26,9 @@ vector_t collision_vec(list_t *shape1, list_t *shape2) {
 /// @param shape2
 /// @return
 collision_info_t *find_collision(list_t *shape1, list_t *shape2) {
-  collision_info_t *collision = malloc(sizeof(collision_info_t));
+  collision_info_t *collision =
+      tracked_malloc(sizeof(collision_info_t), ALLOC_COLLISION);
+  profiler_count(COUNT_SAT_CALLS, 1);
   float minimum_overlap = INFINITY;
   vector_t reflecting_axis;
 
@@ -32,7 +36,7 @@ collision_info_t *find_collision(list_t *shape1, list_t *shape2) {
   size_t num_vertices_shape2 = list_size(shape2);
 
   for (size_t i = 0; i < num_vertices_shape1 + num_vertices_shape2; i++) {
-    vector_t *normal = malloc(sizeof(vector_t));
+    vector_t *normal = tracked_malloc(sizeof(vector_t), ALLOC_COLLISION);
 
     // normal vector for edges of shape1
     if (i < num_vertices_shape1) {
@@ -89,7 +93,7 @@ collision_info_t *find_collision(list_t *shape1, list_t *shape2) {
     if (max_1 < min_2 || max_2 < min_1) {
       // No overlap, i.e polygons do not intersect
       collision->collided = false;
-      free(normal);
+      tracked_free(normal);
       list_free(shape1);
       list_free(shape2);
       return collision;
@@ -117,7 +121,7 @@ collision_info_t *find_collision(list_t *shape1, list_t *shape2) {
         }
       }
     }
-    free(normal);
+    tracked_free(normal);
   }
 
   // all axes overlap
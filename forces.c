@@ -1,14 +1,17 @@
 #include "forces.h"
+#include "alloc.h"
 #include "body.h"
 #include "collision.h"
 #include "list.h"
 #include "math.h"
+#include "profiler.h"
 #include "scene.h"
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
-void aux_freeinator(void *aux) { free(aux); }
+void aux_freeinator(void *aux) { tracked_free(aux); }
 
 typedef struct collision_aux {
   bool already_collided;
@@ -27,7 +30,7 @@ typedef struct impulse_aux {
 
 impulse_aux_t *impulse_aux_init(double elasticity, body_t *body1,
                                 body_t *body2) {
-  impulse_aux_t *impulse = malloc(sizeof(impulse_aux_t));
+  impulse_aux_t *impulse = tracked_malloc(sizeof(impulse_aux_t), ALLOC_FORCE);
   impulse->elasticity = elasticity;
   impulse->body1 = body1;
   impulse->body2 = body2;
@@ -36,7 +39,7 @@ impulse_aux_t *impulse_aux_init(double elasticity, body_t *body1,
 
 collision_aux_t *collision_aux_init(void *aux, body_t *body1, body_t *body2,
                                     collision_handler_t handler) {
-  collision_aux_t *out = malloc(sizeof(collision_aux_t));
+  collision_aux_t *out = tracked_malloc(sizeof(collision_aux_t), ALLOC_FORCE);
   out->aux = aux;
   out->already_collided = false;
   out->handler = handler;
@@ -46,8 +49,8 @@ collision_aux_t *collision_aux_init(void *aux, body_t *body1, body_t *body2,
 }
 
 void collision_free(collision_aux_t *collision_aux) {
-  free(collision_aux->aux);
-  free(collision_aux);
+  tracked_free(collision_aux->aux);
+  tracked_free(collision_aux);
 }
 
 void force_free(force_t *force) {
@@ -60,11 +63,11 @@ void force_free(force_t *force) {
   if (force->bodies != NULL) {
     list_free(force->bodies);
   }
-  free(force);
+  tracked_free(force);
 }
 
 force_t *force_init(void *aux, force_creator_t forcer, free_func_t freer) {
-  force_t *force = malloc(sizeof(force_t));
+  force_t *force = tracked_malloc(sizeof(force_t), ALLOC_FORCE);
   assert(force != NULL);
   force->aux = aux;
   force->forcer = forcer;
@@ -75,7 +78,7 @@ force_t *force_init(void *aux, force_creator_t forcer, free_func_t freer) {
 
 force_t *force_init_with_bodies(void *aux, force_creator_t forcer,
                                 list_t *bodies, free_func_t freer) {
-  force_t *force = malloc(sizeof(force_t));
+  force_t *force = tracked_malloc(sizeof(force_t), ALLOC_FORCE);
   assert(force != NULL);
   force->aux = aux;
   force->forcer = forcer;
@@ -91,7 +94,7 @@ typedef struct two_body_aux {
 } two_body_aux_t;
 
 two_body_aux_t *two_body_init(double constant, body_t *body1, body_t *body2) {
-  two_body_aux_t *out = malloc(sizeof(two_body_aux_t));
+  two_body_aux_t *out = tracked_malloc(sizeof(two_body_aux_t), ALLOC_FORCE);
   assert(out != NULL);
   out->constant = constant;
   out->body1 = body1;
@@ -193,7 +196,7 @@ typedef struct one_body_aux {
 } one_body_aux_t;
 
 one_body_aux_t *one_body_init(double gamma, body_t *body) {
-  one_body_aux_t *out = malloc(sizeof(one_body_aux_t));
+  one_body_aux_t *out = tracked_malloc(sizeof(one_body_aux_t), ALLOC_FORCE);
   assert(out != NULL);
   out->gamma = gamma;
   out->body = body;
@@ -318,6 +321,7 @@ void create_collision(scene_t *scene, body_t *body1, body_t *body2,
 }
 
 void apply_collision(void *aux) {
+  profiler_begin(PROFILE_COLLISION);
   collision_aux_t *collider_aux = (collision_aux_t *)aux;
   vector_t axis = collision_vec(body_get_shape(collider_aux->body1),
                           body_get_shape(collider_aux->body2));
@@ -329,4 +333,146 @@ void apply_collision(void *aux) {
   }
   collider_aux->already_collided = collision_checker(
       body_get_shape(collider_aux->body1), body_get_shape(collider_aux->body2));
-}
\ No newline at end of file
+  profiler_end(PROFILE_COLLISION);
+}
+
+// stable identifiers for force kinds in snapshots; never renumber these
+enum force_kind {
+  NEWTONIAN_GRAVITY_FORCE = 1,
+  SPRING_FORCE = 2,
+  VORTEX_FORCE = 3,
+  DRAG_FORCE = 4,
+  DESTRUCTIVE_COLLISION = 5,
+  PHYSICS_COLLISION = 6,
+  DELETE_BOUNCE_COLLISION = 7,
+  COIN_COLLECTING_COLLISION = 8,
+  VELOCITY_COLLISION = 9,
+  END_GAME_COLLISION = 10
+};
+
+const char *FORCE_NAMES[] = {
+    [NEWTONIAN_GRAVITY_FORCE] = "newtonian gravity",
+    [SPRING_FORCE] = "spring",
+    [VORTEX_FORCE] = "vortex",
+    [DRAG_FORCE] = "drag",
+    [DESTRUCTIVE_COLLISION] = "destructive collision",
+    [PHYSICS_COLLISION] = "physics collision",
+    [DELETE_BOUNCE_COLLISION] = "delete bounce collision",
+    [COIN_COLLECTING_COLLISION] = "coin collecting collision",
+    [VELOCITY_COLLISION] = "velocity collision",
+    [END_GAME_COLLISION] = "end game collision"};
+
+// describes a force created by one of the create_* functions above; returns
+// false for forces it can't describe, such as custom collision handlers
+bool force_encode(force_t *force, uint32_t *kind, double *constant,
+                  bool *collided) {
+  *constant = 0;
+  *collided = false;
+  if (force->forcer == (force_creator_t)apply_newtonian_gravity ||
+      force->forcer == (force_creator_t)apply_spring_force ||
+      force->forcer == (force_creator_t)apply_vortex) {
+    *constant = ((two_body_aux_t *)force->aux)->constant;
+    *kind = force->forcer == (force_creator_t)apply_newtonian_gravity
+                ? NEWTONIAN_GRAVITY_FORCE
+            : force->forcer == (force_creator_t)apply_spring_force
+                ? SPRING_FORCE
+                : VORTEX_FORCE;
+    return true;
+  }
+  if (force->forcer == (force_creator_t)apply_drag_force) {
+    *constant = ((one_body_aux_t *)force->aux)->gamma;
+    *kind = DRAG_FORCE;
+    return true;
+  }
+  if (force->forcer != (force_creator_t)apply_collision) {
+    return false;
+  }
+  collision_aux_t *collision = (collision_aux_t *)force->aux;
+  collision_handler_t handler = collision->handler;
+  if (handler == (collision_handler_t)apply_destructive_collision) {
+    *kind = DESTRUCTIVE_COLLISION;
+  } else if (handler == (collision_handler_t)apply_physics_collision) {
+    *kind = PHYSICS_COLLISION;
+  } else if (handler == (collision_handler_t)apply_delete_bounce) {
+    *kind = DELETE_BOUNCE_COLLISION;
+  } else if (handler == (collision_handler_t)apply_coin_collecting) {
+    *kind = COIN_COLLECTING_COLLISION;
+  } else if (handler == (collision_handler_t)apply_collision_velocity) {
+    *kind = VELOCITY_COLLISION;
+  } else if (handler == (collision_handler_t)apply_end_game) {
+    *kind = END_GAME_COLLISION;
+  } else {
+    // a custom handler's aux may be anything, even NULL
+    return false;
+  }
+  // every handler above was created with an impulse_aux_t
+  *collided = collision->already_collided;
+  *constant = ((impulse_aux_t *)collision->aux)->elasticity;
+  return true;
+}
+
+// how many bodies a force of kind acts on, or 0 if kind isn't one
+// force_encode produces
+size_t force_kind_bodies(uint32_t kind) {
+  if (kind == DRAG_FORCE) {
+    return 1;
+  }
+  return kind >= NEWTONIAN_GRAVITY_FORCE && kind <= END_GAME_COLLISION ? 2 : 0;
+}
+
+// recreates a force described by force_encode; body2 is ignored for drag
+void force_decode(scene_t *scene, uint32_t kind, body_t *body1, body_t *body2,
+                  double constant) {
+  switch (kind) {
+  case NEWTONIAN_GRAVITY_FORCE:
+    create_newtonian_gravity(scene, constant, body1, body2);
+    break;
+  case SPRING_FORCE:
+    create_spring(scene, constant, body1, body2);
+    break;
+  case VORTEX_FORCE:
+    create_vortex(scene, constant, body1, body2);
+    break;
+  case DRAG_FORCE:
+    create_drag(scene, constant, body1);
+    break;
+  case DESTRUCTIVE_COLLISION:
+    create_destructive_collision(scene, body1, body2);
+    break;
+  case PHYSICS_COLLISION:
+    create_physics_collision(scene, constant, body1, body2);
+    break;
+  case DELETE_BOUNCE_COLLISION:
+    create_delete_bounce(scene, constant, body1, body2);
+    break;
+  case COIN_COLLECTING_COLLISION:
+    create_coin_collecting(scene, body1, body2);
+    break;
+  case VELOCITY_COLLISION:
+    create_collision_velocity(scene, body1, body2);
+    break;
+  case END_GAME_COLLISION:
+    create_end_game(scene, body1, body2);
+    break;
+  default:
+    assert(false);
+  }
+}
+
+void force_set_collided(force_t *force, bool collided) {
+  if (force->forcer == (force_creator_t)apply_collision) {
+    ((collision_aux_t *)force->aux)->already_collided = collided;
+  }
+}
+
+// a static name for the force's kind, for traces and reports
+const char *force_get_name(force_t *force) {
+  uint32_t kind;
+  double constant;
+  bool collided;
+  if (!force_encode(force, &kind, &constant, &collided)) {
+    return force->forcer == (force_creator_t)apply_collision ? "collision"
+                                                             : "force";
+  }
+  return FORCE_NAMES[kind];
+}
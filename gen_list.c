@@ -1,4 +1,5 @@
 #include "gen_list.h"
+#include "alloc.h"
 #include "vector.h"
 #include <assert.h>
 #include <stddef.h>
@@ -11,20 +12,20 @@ typedef struct gen_list {
 } gen_list_t;
 
 gen_list_t *gen_list_init(size_t initial_size) {
-  gen_list_t *out = malloc(sizeof(gen_list_t));
+  gen_list_t *out = tracked_malloc(sizeof(gen_list_t), ALLOC_LIST);
   out->size = 0;
   out->capacity = initial_size;
-  out->arr = malloc(sizeof(void *) * initial_size);
+  out->arr = tracked_malloc(sizeof(void *) * initial_size, ALLOC_LIST);
   return out;
 }
 
 void gen_list_resize(gen_list_t *curr) {
-  void **out = malloc(sizeof(void *) * curr->capacity * 2);
+  void **out = tracked_malloc(sizeof(void *) * curr->capacity * 2, ALLOC_LIST);
   curr->capacity = curr->capacity * 2;
   for (size_t i = 0; i < curr->size; i++) {
     out[i] = curr->arr[i];
   }
-  free(curr->arr);
+  tracked_free(curr->arr);
   curr->arr = out;
 }
 
@@ -32,8 +33,8 @@ void gen_list_free(gen_list_t *list, gen_free_t free_inator) {
   for (size_t i = 0; i < list->size; i++) {
     free_inator(list->arr[i]);
   }
-  free(list->arr);
-  free(list);
+  tracked_free(list->arr);
+  tracked_free(list);
 }
 
 size_t gen_list_size(gen_list_t *list) { return list->size; }
@@ -0,0 +1,82 @@
+#include "geometry.h"
+#include "list.h"
+#include "vector.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+typedef struct geometry {
+  vector_t *vertices;
+  size_t size;
+  vector_t min;
+  vector_t max;
+  size_t references;
+} geometry_t;
+
+geometry_t *geometry_init(list_t *shape, vector_t centroid) {
+  size_t size = list_size(shape);
+  assert(size > 0);
+  geometry_t *out = malloc(sizeof(geometry_t));
+  assert(out != NULL);
+  out->vertices = malloc(sizeof(vector_t) * size);
+  assert(out->vertices != NULL);
+  out->size = size;
+  out->references = 1;
+  for (size_t i = 0; i < size; i++) {
+    vector_t local = vec_subtract(*(vector_t *)list_get(shape, i), centroid);
+    out->vertices[i] = local;
+    if (i == 0) {
+      out->min = local;
+      out->max = local;
+    }
+    out->min.x = fmin(out->min.x, local.x);
+    out->min.y = fmin(out->min.y, local.y);
+    out->max.x = fmax(out->max.x, local.x);
+    out->max.y = fmax(out->max.y, local.y);
+  }
+  return out;
+}
+
+geometry_t *geometry_init_local(const vector_t *vertices, size_t size) {
+  assert(size > 0);
+  geometry_t *out = malloc(sizeof(geometry_t));
+  assert(out != NULL);
+  out->vertices = malloc(sizeof(vector_t) * size);
+  assert(out->vertices != NULL);
+  out->size = size;
+  out->references = 1;
+  out->min = vertices[0];
+  out->max = vertices[0];
+  for (size_t i = 0; i < size; i++) {
+    out->vertices[i] = vertices[i];
+    out->min.x = fmin(out->min.x, vertices[i].x);
+    out->min.y = fmin(out->min.y, vertices[i].y);
+    out->max.x = fmax(out->max.x, vertices[i].x);
+    out->max.y = fmax(out->max.y, vertices[i].y);
+  }
+  return out;
+}
+
+geometry_t *geometry_retain(geometry_t *geometry) {
+  geometry->references++;
+  return geometry;
+}
+
+void geometry_release(geometry_t *geometry) {
+  assert(geometry->references > 0);
+  geometry->references--;
+  if (geometry->references == 0) {
+    free(geometry->vertices);
+    free(geometry);
+  }
+}
+
+size_t geometry_size(geometry_t *geometry) { return geometry->size; }
+
+const vector_t *geometry_get_vertices(geometry_t *geometry) {
+  return geometry->vertices;
+}
+
+vector_t geometry_get_min(geometry_t *geometry) { return geometry->min; }
+
+vector_t geometry_get_max(geometry_t *geometry) { return geometry->max; }
@@ -0,0 +1,74 @@
+#include "headless_wrapper.h"
+#include "alloc.h"
+#include "profiler.h"
+#include "sdl_wrapper.h"
+#include "state.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Runs the game as fast as possible against headless_wrapper.c.
+// usage: headless [--script FILE] [--seconds N] [--step DT] [--seed S]
+//                 [--record FILE] [--replay FILE] [--trace FILE]
+// A replay runs until its recording ends, however long --seconds is, and
+// exits with 1 if the game diverged from it.
+
+double wall_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  double step = 1.0 / 60;
+  double seconds = 30;
+  uint64_t seed = 3;
+  const char *script = NULL;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--script") == 0) {
+      script = argv[i + 1];
+    } else if (strcmp(argv[i], "--seconds") == 0) {
+      seconds = atof(argv[i + 1]);
+    } else if (strcmp(argv[i], "--step") == 0) {
+      step = atof(argv[i + 1]);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = strtoull(argv[i + 1], NULL, 10);
+    } else if (strcmp(argv[i], "--record") == 0) {
+      setenv("STALKER_RECORD", argv[i + 1], 1);
+    } else if (strcmp(argv[i], "--trace") == 0) {
+      setenv("STALKER_TRACE", argv[i + 1], 1);
+    } else if (strcmp(argv[i], "--replay") == 0) {
+      setenv("STALKER_REPLAY", argv[i + 1], 1);
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (getenv("STALKER_REPLAY") != NULL) {
+    seconds = INFINITY;
+  }
+  headless_configure(step, seconds, seed);
+  if (script != NULL && headless_load_script(script) != 0) {
+    fprintf(stderr, "couldn't open script %s\n", script);
+    return 1;
+  }
+
+  double start = wall_seconds();
+  size_t frames = 0;
+  state_t *state = emscripten_init();
+  while (!sdl_is_done(state) && !game_replay_finished(state)) {
+    emscripten_main(state);
+    frames++;
+  }
+  bool diverged = game_replay_diverged(state);
+  emscripten_free(state);
+  double elapsed = wall_seconds() - start;
+  printf("frames %zu simulated %.2fs wall %.3fs (%.0f frames/s)\n", frames,
+         headless_get_time(), elapsed, frames / elapsed);
+  profiler_print(stdout);
+  alloc_print(stdout);
+  return diverged ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+#include "headless_wrapper.h"
+#include "sdl_wrapper.h"
+#include "list.h"
+#include "scene.h"
+#include "state.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Null render/audio backend with the same interface as sdl_wrapper.c.
+// Linking this file instead of sdl_wrapper.c runs the game with no window,
+// a virtual clock advanced by a fixed step per frame, and key events read
+// from a script instead of SDL.
+
+const double DEFAULT_HEADLESS_STEP = 1.0 / 60;
+const double DEFAULT_HEADLESS_DURATION = 30;
+
+typedef struct scripted_key {
+  double time;
+  char key;
+  key_event_type_t type;
+} scripted_key_t;
+
+/**
+ * The keypress handler, or NULL if none has been configured.
+ */
+key_handler_t key_handler = NULL;
+/**
+ * Virtual time in seconds, advanced by headless_step on every
+ * time_since_last_tick().
+ */
+double headless_time = 0;
+double headless_step = DEFAULT_HEADLESS_STEP;
+double headless_duration = DEFAULT_HEADLESS_DURATION;
+uint64_t session_seed = 0;
+/**
+ * Scripted key events sorted by time, and the next one to dispatch.
+ */
+scripted_key_t *headless_script = NULL;
+size_t headless_script_size = 0;
+size_t headless_script_next = 0;
+/**
+ * Virtual time when each key was last pressed, used for held_time.
+ */
+double headless_key_start = 0;
+
+void headless_configure(double frame_step, double seconds, uint64_t seed) {
+  assert(frame_step > 0);
+  headless_step = frame_step;
+  headless_duration = seconds;
+  session_seed = seed;
+}
+
+char headless_parse_key(const char *name) {
+  if (strcmp(name, "left") == 0) {
+    return LEFT_ARROW;
+  } else if (strcmp(name, "up") == 0) {
+    return UP_ARROW;
+  } else if (strcmp(name, "right") == 0) {
+    return RIGHT_ARROW;
+  } else if (strcmp(name, "down") == 0) {
+    return DOWN_ARROW;
+  } else if (strcmp(name, "space") == 0) {
+    return SPACE_BAR;
+  } else if (strcmp(name, "w") == 0) {
+    return W_KEY;
+  } else if (strcmp(name, "a") == 0) {
+    return A_KEY;
+  } else if (strcmp(name, "s") == 0) {
+    return S_KEY;
+  } else if (strcmp(name, "d") == 0) {
+    return D_KEY;
+  }
+  return strlen(name) == 1 ? name[0] : '\0';
+}
+
+// reads "<seconds> <key> <press|release>" lines; # starts a comment
+// -1 = error, 0 = okay
+int headless_load_script(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return -1;
+  }
+  size_t capacity = 16;
+  headless_script =
+      realloc(headless_script, sizeof(scripted_key_t) * capacity);
+  assert(headless_script != NULL);
+  headless_script_size = 0;
+  headless_script_next = 0;
+  char line[128];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    double time;
+    char key_name[16];
+    char type_name[16];
+    if (line[0] == '#' ||
+        sscanf(line, "%lf %15s %15s", &time, key_name, type_name) != 3) {
+      continue;
+    }
+    char key = headless_parse_key(key_name);
+    if (key == '\0') {
+      continue;
+    }
+    if (headless_script_size >= capacity) {
+      capacity *= 2;
+      headless_script =
+          realloc(headless_script, sizeof(scripted_key_t) * capacity);
+      assert(headless_script != NULL);
+    }
+    // keep the script sorted on insertion; scripts are written mostly in order
+    size_t index = headless_script_size;
+    while (index > 0 && headless_script[index - 1].time > time) {
+      headless_script[index] = headless_script[index - 1];
+      index--;
+    }
+    headless_script[index] = (scripted_key_t){
+        .time = time,
+        .key = key,
+        .type = strcmp(type_name, "release") == 0 ? KEY_RELEASED
+                                                   : KEY_PRESSED};
+    headless_script_size++;
+  }
+  fclose(file);
+  return 0;
+}
+
+double headless_get_time(void) { return headless_time; }
+
+void sdl_init(vector_t min, vector_t max) {
+  assert(min.x < max.x);
+  assert(min.y < max.y);
+  headless_time = 0;
+  headless_script_next = 0;
+}
+
+uint64_t sdl_session_seed(void) { return session_seed; }
+
+bool sdl_is_done(state_t *state) {
+  while (headless_script_next < headless_script_size &&
+         headless_script[headless_script_next].time <= headless_time) {
+    scripted_key_t *event = &headless_script[headless_script_next++];
+    if (key_handler == NULL) {
+      continue;
+    }
+    if (event->type == KEY_PRESSED) {
+      headless_key_start = event->time;
+    }
+    key_handler(event->key, event->type, event->time - headless_key_start,
+                state);
+  }
+  return headless_time >= headless_duration;
+}
+
+void sdl_clear(void) {}
+
+void sdl_draw_polygon(list_t *points, rgb_color_t color) {}
+
+void sdl_show(void) {}
+
+void sdl_load_assets(void) {}
+
+void sdl_pump_assets(void) {}
+
+void sdl_render_snapshot(render_snapshot_t *snapshot) {}
+
+void sdl_render_scene(scene_t *scene) {}
+
+void sdl_render_text_time(time_t time_left) {}
+
+void sdl_render_text_coin_count(size_t coins) {}
+
+void sdl_render_text_coins(body_t *body) {}
+
+int sdl_render_music() { return 0; }
+
+int sdl_render_sfx(sfx_t sound_to_make) { return 0; }
+
+void sdl_on_key(key_handler_t handler) { key_handler = handler; }
+
+double time_since_last_tick(void) {
+  headless_time += headless_step;
+  return headless_step;
+}
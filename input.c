@@ -0,0 +1,101 @@
+#include "input.h"
+#include "sdl_wrapper.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Single-producer single-consumer ring of key events, for handing input
+// from the thread polling the window to the thread running the game
+// without locks. Head and tail only ever increase; each is written by one
+// side and read by the other. Events carry the time they were captured, so
+// the consumer can tell how long each one waited to be applied.
+
+typedef struct input_ring {
+  input_event_t *events;
+  // a power of two, so indices wrap with a mask
+  size_t capacity;
+  // next slot the consumer reads
+  atomic_size_t head;
+  // next slot the producer writes
+  atomic_size_t tail;
+  // producer only
+  atomic_size_t dropped;
+  // consumer only: events popped and how long they waited
+  size_t taken;
+  double total_latency;
+  double max_latency;
+} input_ring_t;
+
+double input_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+input_ring_t *input_ring_init(size_t capacity) {
+  assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  input_ring_t *out = malloc(sizeof(input_ring_t));
+  assert(out != NULL);
+  out->events = malloc(sizeof(input_event_t) * capacity);
+  assert(out->events != NULL);
+  out->capacity = capacity;
+  atomic_init(&out->head, 0);
+  atomic_init(&out->tail, 0);
+  atomic_init(&out->dropped, 0);
+  out->taken = 0;
+  out->total_latency = 0;
+  out->max_latency = 0;
+  return out;
+}
+
+void input_ring_free(input_ring_t *ring) {
+  free(ring->events);
+  free(ring);
+}
+
+// producer only; false if the ring is full and event was dropped
+bool input_ring_push(input_ring_t *ring, input_event_t event) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (tail - head == ring->capacity) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return false;
+  }
+  ring->events[tail & (ring->capacity - 1)] = event;
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+// consumer only; false if the ring is empty. The event's latency is
+// measured from its timestamp to now.
+bool input_ring_pop(input_ring_t *ring, input_event_t *event) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+  *event = ring->events[head & (ring->capacity - 1)];
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  double latency = input_clock() - event->timestamp;
+  ring->taken++;
+  ring->total_latency += latency;
+  if (latency > ring->max_latency) {
+    ring->max_latency = latency;
+  }
+  return true;
+}
+
+// the rest are for the consumer
+size_t input_ring_taken(input_ring_t *ring) { return ring->taken; }
+
+size_t input_ring_dropped(input_ring_t *ring) {
+  return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
+
+double input_ring_mean_latency(input_ring_t *ring) {
+  return ring->taken > 0 ? ring->total_latency / ring->taken : 0;
+}
+
+double input_ring_max_latency(input_ring_t *ring) { return ring->max_latency; }
@@ -1,4 +1,5 @@
 #include "list.h"
+#include "alloc.h"
 #include "vector.h"
 #include <assert.h>
 #include <stddef.h>
@@ -12,22 +13,23 @@ typedef struct list {
 } list_t;
 
 list_t *list_init(size_t initial_size, free_func_t free_inator) {
-  list_t *out = malloc(sizeof(list_t));
+  list_t *out = tracked_malloc(sizeof(list_t), ALLOC_LIST);
   assert(out != NULL);
   out->size = 0;
   out->capacity = initial_size;
-  out->arr = malloc(sizeof(void *) * initial_size);
+  out->arr = tracked_malloc(sizeof(void *) * initial_size, ALLOC_LIST);
   out->free_inator = free_inator;
   return out;
 }
 
 void list_resize(list_t *curr) {
-  void **out = malloc(sizeof(void *) * (curr->capacity * 2 + 1));
+  void **out =
+      tracked_malloc(sizeof(void *) * (curr->capacity * 2 + 1), ALLOC_LIST);
   curr->capacity = curr->capacity * 2 + 1;
   for (size_t i = 0; i < curr->size; i++) {
     out[i] = curr->arr[i];
   }
-  free(curr->arr);
+  tracked_free(curr->arr);
   curr->arr = out;
 }
 
@@ -37,8 +39,8 @@ void list_free(list_t *list) {
       list->free_inator(list->arr[i]);
     }
   }
-  free(list->arr);
-  free(list);
+  tracked_free(list->arr);
+  tracked_free(list);
 }
 
 size_t list_size(list_t *list) { return list->size; }
@@ -0,0 +1,243 @@
+#include "loader.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Manifest-driven asset loader. Each manifest line is
+//   <image|sound|music|font> <name> <path> [critical]
+// and # starts a comment. Worker threads decode assets through the caller's
+// decoder, critical ones first, and the render thread collects finished
+// assets with loader_next_ready() so anything touching the GPU stays on it.
+// Workers claim assets through one counter and publish each result with a
+// release store, so the only lock is for waiting on critical assets.
+
+const char *ASSET_KIND_NAMES[NUM_ASSET_KINDS] = {[ASSET_IMAGE] = "image",
+                                                 [ASSET_SOUND] = "sound",
+                                                 [ASSET_MUSIC] = "music",
+                                                 [ASSET_FONT] = "font"};
+
+const size_t MAX_MANIFEST_LINE = 512;
+
+typedef struct asset {
+  asset_kind_t kind;
+  char *name;
+  char *path;
+  bool critical;
+  void *data;
+  atomic_bool ready;
+  // only touched by the thread calling loader_next_ready()
+  bool taken;
+} asset_t;
+
+typedef struct loader {
+  asset_t *assets;
+  size_t size;
+  asset_decoder_t decode;
+  atomic_size_t next_asset;
+  size_t threads;
+  pthread_t *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t critical_done;
+  size_t critical_left;
+} loader_t;
+
+int asset_compare(const void *a, const void *b) {
+  const asset_t *first = a, *second = b;
+  return (int)second->critical - (int)first->critical;
+}
+
+// -1 = error, 0 = okay
+int parse_manifest(loader_t *loader, FILE *file) {
+  char line[MAX_MANIFEST_LINE];
+  size_t capacity = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char *comment = strchr(line, '#');
+    if (comment != NULL) {
+      *comment = '\0';
+    }
+    char kind[16], name[128], path[256], flag[16];
+    int fields = sscanf(line, "%15s %127s %255s %15s", kind, name, path, flag);
+    if (fields <= 0) {
+      continue;
+    }
+    if (fields < 3 || (fields == 4 && strcmp(flag, "critical") != 0)) {
+      return -1;
+    }
+    size_t k = 0;
+    while (k < NUM_ASSET_KINDS && strcmp(kind, ASSET_KIND_NAMES[k]) != 0) {
+      k++;
+    }
+    if (k == NUM_ASSET_KINDS) {
+      return -1;
+    }
+    if (loader->size == capacity) {
+      capacity = capacity > 0 ? capacity * 2 : 16;
+      loader->assets = realloc(loader->assets, sizeof(asset_t) * capacity);
+      assert(loader->assets != NULL);
+    }
+    asset_t *asset = &loader->assets[loader->size++];
+    asset->kind = k;
+    asset->name = strdup(name);
+    asset->path = strdup(path);
+    asset->critical = fields == 4;
+    asset->data = NULL;
+    atomic_init(&asset->ready, false);
+    asset->taken = false;
+  }
+  return 0;
+}
+
+void *loader_worker(void *aux) {
+  loader_t *loader = aux;
+  while (true) {
+    size_t index = atomic_fetch_add(&loader->next_asset, 1);
+    if (index >= loader->size) {
+      return NULL;
+    }
+    asset_t *asset = &loader->assets[index];
+    asset->data = loader->decode(asset->kind, asset->path);
+    if (asset->data == NULL) {
+      fprintf(stderr, "couldn't load %s %s from %s\n",
+              ASSET_KIND_NAMES[asset->kind], asset->name, asset->path);
+    }
+    atomic_store_explicit(&asset->ready, true, memory_order_release);
+    if (asset->critical) {
+      pthread_mutex_lock(&loader->lock);
+      loader->critical_left--;
+      pthread_cond_broadcast(&loader->critical_done);
+      pthread_mutex_unlock(&loader->lock);
+    }
+  }
+}
+
+void loader_free_assets(loader_t *loader) {
+  for (size_t i = 0; i < loader->size; i++) {
+    free(loader->assets[i].name);
+    free(loader->assets[i].path);
+  }
+  free(loader->assets);
+  free(loader);
+}
+
+// starts decoding everything in the manifest on threads workers;
+// returns NULL if the manifest can't be read
+loader_t *loader_init(const char *manifest, size_t threads,
+                      asset_decoder_t decode) {
+  assert(threads > 0);
+  FILE *file = fopen(manifest, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+  loader_t *loader = malloc(sizeof(loader_t));
+  assert(loader != NULL);
+  loader->assets = NULL;
+  loader->size = 0;
+  int parsed = parse_manifest(loader, file);
+  fclose(file);
+  if (parsed != 0) {
+    fprintf(stderr, "bad asset manifest %s\n", manifest);
+    loader_free_assets(loader);
+    return NULL;
+  }
+  // critical assets are claimed first, the rest in any order
+  if (loader->size > 0) {
+    qsort(loader->assets, loader->size, sizeof(asset_t), asset_compare);
+  }
+  loader->decode = decode;
+  atomic_init(&loader->next_asset, 0);
+  loader->critical_left = 0;
+  for (size_t i = 0; i < loader->size; i++) {
+    loader->critical_left += loader->assets[i].critical;
+  }
+  pthread_mutex_init(&loader->lock, NULL);
+  pthread_cond_init(&loader->critical_done, NULL);
+  loader->workers = malloc(sizeof(pthread_t) * threads);
+  assert(loader->workers != NULL);
+  loader->threads = 0;
+  for (size_t i = 0; i < threads; i++) {
+    if (pthread_create(&loader->workers[i], NULL, loader_worker, loader) !=
+        0) {
+      break;
+    }
+    loader->threads++;
+  }
+  // with no workers at all, decode on this thread instead
+  if (loader->threads == 0) {
+    loader_worker(loader);
+  }
+  return loader;
+}
+
+void loader_wait_critical(loader_t *loader) {
+  pthread_mutex_lock(&loader->lock);
+  while (loader->critical_left > 0) {
+    pthread_cond_wait(&loader->critical_done, &loader->lock);
+  }
+  pthread_mutex_unlock(&loader->lock);
+}
+
+// finds an asset decoded since the last call; false once none are waiting
+bool loader_next_ready(loader_t *loader, size_t *index) {
+  for (size_t i = 0; i < loader->size; i++) {
+    asset_t *asset = &loader->assets[i];
+    if (!asset->taken &&
+        atomic_load_explicit(&asset->ready, memory_order_acquire)) {
+      asset->taken = true;
+      *index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool loader_is_done(loader_t *loader) {
+  for (size_t i = 0; i < loader->size; i++) {
+    if (!loader->assets[i].taken) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t loader_size(loader_t *loader) { return loader->size; }
+
+asset_kind_t loader_get_kind(loader_t *loader, size_t index) {
+  assert(index < loader->size);
+  return loader->assets[index].kind;
+}
+
+const char *loader_get_name(loader_t *loader, size_t index) {
+  assert(index < loader->size);
+  return loader->assets[index].name;
+}
+
+const char *loader_get_path(loader_t *loader, size_t index) {
+  assert(index < loader->size);
+  return loader->assets[index].path;
+}
+
+bool loader_is_critical(loader_t *loader, size_t index) {
+  assert(index < loader->size);
+  return loader->assets[index].critical;
+}
+
+// NULL if decoding failed; only valid once loader_next_ready() returned index
+void *loader_get_data(loader_t *loader, size_t index) {
+  assert(index < loader->size && loader->assets[index].taken);
+  return loader->assets[index].data;
+}
+
+// waits for the workers; decoded data is the caller's to free
+void loader_free(loader_t *loader) {
+  for (size_t i = 0; i < loader->threads; i++) {
+    pthread_join(loader->workers[i], NULL);
+  }
+  free(loader->workers);
+  pthread_mutex_destroy(&loader->lock);
+  pthread_cond_destroy(&loader->critical_done);
+  loader_free_assets(loader);
+}
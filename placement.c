@@ -0,0 +1,195 @@
+#include "placement.h"
+#include "body.h"
+#include "rng.h"
+#include "scene.h"
+#include "vector.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// candidates tried around each active point while building the pool
+const size_t CANDIDATES_PER_POINT = 30;
+const size_t EMPTY_CELL = (size_t)-1;
+
+// hands out spawn positions from a pool of blue-noise points over the spawn
+// region, skipping any that are within spacing of a live body
+typedef struct placement {
+  vector_t min;
+  vector_t max;
+  double spacing;
+  size_t max_attempts;
+  rng_t *rng;
+  vector_t *points;
+  size_t size;
+  size_t capacity;
+  size_t cursor;
+  // background grid for pool generation; a cell is small enough to hold at
+  // most one point, so it stores that point's index
+  size_t *grid;
+  size_t columns;
+  size_t rows;
+  double cell;
+} placement_t;
+
+double placement_random(placement_t *placement) {
+  return rng_double(placement->rng);
+}
+
+size_t placement_cell(placement_t *placement, vector_t point) {
+  size_t column = (size_t)((point.x - placement->min.x) / placement->cell);
+  size_t row = (size_t)((point.y - placement->min.y) / placement->cell);
+  return row * placement->columns + column;
+}
+
+bool placement_in_region(placement_t *placement, vector_t point) {
+  return point.x >= placement->min.x && point.y >= placement->min.y &&
+         point.x < placement->max.x && point.y < placement->max.y;
+}
+
+// checks the 5x5 block of cells around point for a sample closer than spacing
+bool placement_is_free(placement_t *placement, vector_t point) {
+  long column = (long)((point.x - placement->min.x) / placement->cell);
+  long row = (long)((point.y - placement->min.y) / placement->cell);
+  double spacing_squared = placement->spacing * placement->spacing;
+  for (long r = row - 2; r <= row + 2; r++) {
+    for (long c = column - 2; c <= column + 2; c++) {
+      if (r < 0 || c < 0 || r >= (long)placement->rows ||
+          c >= (long)placement->columns) {
+        continue;
+      }
+      size_t index = placement->grid[r * placement->columns + c];
+      if (index == EMPTY_CELL) {
+        continue;
+      }
+      vector_t offset = vec_subtract(placement->points[index], point);
+      if (vec_dot(offset, offset) < spacing_squared) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void placement_add_point(placement_t *placement, vector_t point) {
+  if (placement->size >= placement->capacity) {
+    placement->capacity = placement->capacity * 2 + 1;
+    placement->points =
+        realloc(placement->points, sizeof(vector_t) * placement->capacity);
+    assert(placement->points != NULL);
+  }
+  placement->grid[placement_cell(placement, point)] = placement->size;
+  placement->points[placement->size] = point;
+  placement->size++;
+}
+
+// bridson's algorithm: grow the pool outwards from a random seed point, then
+// shuffle it so consecutive spawns land far apart
+void placement_generate(placement_t *placement) {
+  size_t cells = placement->columns * placement->rows;
+  for (size_t i = 0; i < cells; i++) {
+    placement->grid[i] = EMPTY_CELL;
+  }
+  placement->size = 0;
+  placement->cursor = 0;
+
+  vector_t extent = vec_subtract(placement->max, placement->min);
+  vector_t first = {
+      .x = placement->min.x + placement_random(placement) * extent.x,
+      .y = placement->min.y + placement_random(placement) * extent.y};
+  placement_add_point(placement, first);
+  size_t *active = malloc(sizeof(size_t) * cells);
+  assert(active != NULL);
+  size_t active_size = 0;
+  active[active_size++] = 0;
+
+  while (active_size > 0) {
+    size_t slot = (size_t)(placement_random(placement) * active_size);
+    vector_t origin = placement->points[active[slot]];
+    bool found = false;
+    for (size_t k = 0; k < CANDIDATES_PER_POINT; k++) {
+      double angle = 2 * M_PI * placement_random(placement);
+      double radius = placement->spacing * (1 + placement_random(placement));
+      vector_t candidate =
+          vec_add(origin, (vector_t){.x = radius * cos(angle),
+                                     .y = radius * sin(angle)});
+      if (placement_in_region(placement, candidate) &&
+          placement_is_free(placement, candidate)) {
+        placement_add_point(placement, candidate);
+        active[active_size++] = placement->size - 1;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      active[slot] = active[--active_size];
+    }
+  }
+  free(active);
+
+  for (size_t i = placement->size - 1; i > 0; i--) {
+    size_t j = (size_t)(placement_random(placement) * (i + 1));
+    vector_t temp = placement->points[i];
+    placement->points[i] = placement->points[j];
+    placement->points[j] = temp;
+  }
+}
+
+placement_t *placement_init(vector_t min, vector_t max, double spacing,
+                            size_t max_attempts, rng_t *rng) {
+  assert(min.x < max.x);
+  assert(min.y < max.y);
+  assert(spacing > 0);
+  placement_t *out = malloc(sizeof(placement_t));
+  assert(out != NULL);
+  out->min = min;
+  out->max = max;
+  out->spacing = spacing;
+  out->max_attempts = max_attempts;
+  out->rng = rng_split(rng);
+  out->cell = spacing / sqrt(2);
+  out->columns = (size_t)ceil((max.x - min.x) / out->cell);
+  out->rows = (size_t)ceil((max.y - min.y) / out->cell);
+  out->grid = malloc(sizeof(size_t) * out->columns * out->rows);
+  assert(out->grid != NULL);
+  out->capacity = out->columns * out->rows / 2 + 1;
+  out->points = malloc(sizeof(vector_t) * out->capacity);
+  assert(out->points != NULL);
+  placement_generate(out);
+  return out;
+}
+
+void placement_free(placement_t *placement) {
+  rng_free(placement->rng);
+  free(placement->grid);
+  free(placement->points);
+  free(placement);
+}
+
+// static scenery such as the background and walls has infinite mass and
+// does not count against spacing
+bool placement_blocker(body_t *body, void *aux) {
+  if (body_get_mass(body) == INFINITY || body_is_removed(body)) {
+    return true;
+  }
+  *(bool *)aux = true;
+  return false;
+}
+
+bool placement_sample(placement_t *placement, scene_t *scene,
+                      vector_t *out) {
+  for (size_t attempt = 0; attempt < placement->max_attempts; attempt++) {
+    if (placement->cursor >= placement->size) {
+      placement_generate(placement);
+    }
+    vector_t candidate = placement->points[placement->cursor++];
+    bool blocked = false;
+    scene_query_radius(scene, candidate, placement->spacing,
+                       placement_blocker, &blocked);
+    if (!blocked) {
+      *out = candidate;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,235 @@
+#include "profiler.h"
+#include "color.h"
+#include "list.h"
+#include "sdl_wrapper.h"
+#include "trace.h"
+#include "vector.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Frame profiler. Phases are timed with a monotonic clock and summed over a
+// frame, counters are summed over a frame, and profiler_end_frame() pushes
+// both into rolling windows that percentiles are read from. Phases may nest,
+// so their times are inclusive. Timing compiles to no-ops unless
+// STALKER_PROFILE is defined. Phase boundaries are passed on to trace.c when
+// STALKER_PROFILE or STALKER_TRACING is; with neither, profiler.h turns the
+// hooks into empty inline functions, so they cost nothing in hot paths.
+
+// frames kept for percentiles; 4 seconds at 60 frames per second
+#define PROFILE_WINDOW 240
+
+const char *PHASE_NAMES[NUM_PROFILE_PHASES] = {
+    [PROFILE_FRAME] = "frame",         [PROFILE_SPAWN] = "spawn",
+    [PROFILE_FORCES] = "forces",       [PROFILE_COLLISION] = "collision",
+    [PROFILE_INTEGRATE] = "integrate", [PROFILE_DESPAWN] = "despawn",
+    [PROFILE_REMOVE] = "remove",       [PROFILE_RENDER] = "render",
+    [PROFILE_TEXT] = "text"};
+
+const char *COUNTER_NAMES[NUM_PROFILE_COUNTERS] = {
+    [COUNT_TICKS] = "ticks",
+    [COUNT_BODIES] = "bodies",
+    [COUNT_FORCES] = "forces",
+    [COUNT_SAT_CALLS] = "sat calls",
+    [COUNT_ALLOCATIONS] = "allocations",
+    [COUNT_ALLOCATED_BYTES] = "bytes",
+    [COUNT_BODY_ALLOCATIONS] = "body allocs",
+    [COUNT_FORCE_ALLOCATIONS] = "force allocs",
+    [COUNT_COLLISION_ALLOCATIONS] = "coll allocs",
+    [COUNT_LIST_ALLOCATIONS] = "list allocs",
+    [COUNT_RENDER_ALLOCATIONS] = "render allocs"};
+
+// the overlay's full bar width is one frame at 60 frames per second
+const double OVERLAY_BUDGET = 1.0 / 60;
+const double OVERLAY_BAR_HEIGHT = 8;
+const double OVERLAY_BAR_GAP = 4;
+const rgb_color_t OVERLAY_MEDIAN_COLOR = {.r = 0.2, .g = 0.8, .b = 0.2};
+const rgb_color_t OVERLAY_TAIL_COLOR = {.r = 0.9, .g = 0.3, .b = 0.2};
+
+#ifdef STALKER_PROFILE
+/**
+ * Time in seconds each phase started at, and its total so far this frame.
+ * Per thread, since the batch runner and the asset loader tick and allocate
+ * on threads of their own; only the thread calling profiler_end_frame()
+ * reports its totals.
+ */
+_Thread_local double phase_start[NUM_PROFILE_PHASES];
+_Thread_local double phase_total[NUM_PROFILE_PHASES];
+_Thread_local double counter_total[NUM_PROFILE_COUNTERS];
+/**
+ * Completed frames, oldest overwritten first; only touched by the thread
+ * running the frame loop.
+ */
+double phase_window[NUM_PROFILE_PHASES][PROFILE_WINDOW];
+double counter_window[NUM_PROFILE_COUNTERS][PROFILE_WINDOW];
+size_t window_next = 0;
+size_t window_size = 0;
+
+double profiler_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int double_compare(const void *a, const void *b) {
+  double first = *(const double *)a;
+  double second = *(const double *)b;
+  return first < second ? -1 : first > second;
+}
+
+// nearest-rank percentile of the frames in window, p in [0, 1]
+double window_percentile(const double *window, double p) {
+  if (window_size == 0) {
+    return 0;
+  }
+  double sorted[PROFILE_WINDOW];
+  memcpy(sorted, window, sizeof(double) * window_size);
+  qsort(sorted, window_size, sizeof(double), double_compare);
+  size_t rank = (size_t)(p * (window_size - 1) + 0.5);
+  return sorted[rank];
+}
+#endif
+
+#if defined(STALKER_PROFILE) || defined(STALKER_TRACING)
+void profiler_begin(profile_phase_t phase) {
+  trace_begin(PHASE_NAMES[phase]);
+#ifdef STALKER_PROFILE
+  phase_start[phase] = profiler_now();
+#endif
+}
+
+void profiler_end(profile_phase_t phase) {
+#ifdef STALKER_PROFILE
+  phase_total[phase] += profiler_now() - phase_start[phase];
+#endif
+  trace_end(PHASE_NAMES[phase]);
+}
+
+void profiler_count(profile_counter_t counter, size_t amount) {
+#ifdef STALKER_PROFILE
+  counter_total[counter] += amount;
+#endif
+}
+
+// for counters that are levels rather than events, like the body count
+void profiler_set(profile_counter_t counter, size_t value) {
+#ifdef STALKER_PROFILE
+  counter_total[counter] = value;
+#endif
+}
+#endif
+
+void profiler_end_frame(void) {
+#ifdef STALKER_PROFILE
+  for (size_t p = 0; p < NUM_PROFILE_PHASES; p++) {
+    phase_window[p][window_next] = phase_total[p];
+    phase_total[p] = 0;
+  }
+  for (size_t c = 0; c < NUM_PROFILE_COUNTERS; c++) {
+    counter_window[c][window_next] = counter_total[c];
+    counter_total[c] = 0;
+  }
+  window_next = (window_next + 1) % PROFILE_WINDOW;
+  if (window_size < PROFILE_WINDOW) {
+    window_size++;
+  }
+#endif
+}
+
+bool profiler_is_enabled(void) {
+#ifdef STALKER_PROFILE
+  return true;
+#else
+  return false;
+#endif
+}
+
+// seconds spent in phase per frame, over the last PROFILE_WINDOW frames
+double profiler_phase_percentile(profile_phase_t phase, double p) {
+#ifdef STALKER_PROFILE
+  return window_percentile(phase_window[phase], p);
+#else
+  return 0;
+#endif
+}
+
+// counter per frame; frames run as many fixed ticks as COUNT_TICKS says
+double profiler_counter_percentile(profile_counter_t counter, double p) {
+#ifdef STALKER_PROFILE
+  return window_percentile(counter_window[counter], p);
+#else
+  return 0;
+#endif
+}
+
+const char *profiler_phase_name(profile_phase_t phase) {
+  return PHASE_NAMES[phase];
+}
+
+const char *profiler_counter_name(profile_counter_t counter) {
+  return COUNTER_NAMES[counter];
+}
+
+void profiler_print(FILE *out) {
+  if (!profiler_is_enabled()) {
+    return;
+  }
+  fprintf(out, "%-12s %10s %10s %10s\n", "phase", "p50 us", "p90 us",
+          "p99 us");
+  for (size_t p = 0; p < NUM_PROFILE_PHASES; p++) {
+    fprintf(out, "%-12s %10.1f %10.1f %10.1f\n", PHASE_NAMES[p],
+            profiler_phase_percentile(p, 0.5) * 1e6,
+            profiler_phase_percentile(p, 0.9) * 1e6,
+            profiler_phase_percentile(p, 0.99) * 1e6);
+  }
+  fprintf(out, "%-12s %10s %10s %10s\n", "per frame", "p50", "p90", "p99");
+  for (size_t c = 0; c < NUM_PROFILE_COUNTERS; c++) {
+    fprintf(out, "%-12s %10.0f %10.0f %10.0f\n", COUNTER_NAMES[c],
+            profiler_counter_percentile(c, 0.5),
+            profiler_counter_percentile(c, 0.9),
+            profiler_counter_percentile(c, 0.99));
+  }
+}
+
+void draw_bar(vector_t corner, double width, rgb_color_t color) {
+  list_t *bar = list_init(4, free);
+  vector_t points[] = {
+      corner,
+      {.x = corner.x + width, .y = corner.y},
+      {.x = corner.x + width, .y = corner.y + OVERLAY_BAR_HEIGHT},
+      {.x = corner.x, .y = corner.y + OVERLAY_BAR_HEIGHT}};
+  for (size_t i = 0; i < 4; i++) {
+    vector_t *point = malloc(sizeof(vector_t));
+    assert(point != NULL);
+    *point = points[i];
+    list_add(bar, point);
+  }
+  sdl_draw_polygon(bar, color);
+  list_free(bar);
+}
+
+// one bar per phase from origin downwards, p99 behind p50, with width
+// standing for a whole 60 fps frame
+void profiler_draw_overlay(vector_t origin, double width) {
+  if (!profiler_is_enabled()) {
+    return;
+  }
+  for (size_t p = 0; p < NUM_PROFILE_PHASES; p++) {
+    vector_t corner = {
+        .x = origin.x,
+        .y = origin.y + p * (OVERLAY_BAR_HEIGHT + OVERLAY_BAR_GAP)};
+    double tail = profiler_phase_percentile(p, 0.99) / OVERLAY_BUDGET;
+    double median = profiler_phase_percentile(p, 0.5) / OVERLAY_BUDGET;
+    // sdl_draw_polygon needs a real polygon, so skip empty bars
+    if (tail * width >= 1) {
+      draw_bar(corner, tail * width, OVERLAY_TAIL_COLOR);
+    }
+    if (median * width >= 1) {
+      draw_bar(corner, median * width, OVERLAY_MEDIAN_COLOR);
+    }
+  }
+}
@@ -0,0 +1,179 @@
+#include "render_snapshot.h"
+#include "body.h"
+#include "scene.h"
+#include "vector.h"
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// What the renderer needs from a scene, copied out so it can be drawn
+// while the simulation keeps changing the scene. Bodies become flat items
+// with their world-space outline in one shared vertex array; buffers are
+// kept and reused between captures.
+//
+// A render buffer hands snapshots from one writer thread to one reader
+// thread through three slots: the writer fills its back slot and swaps it
+// into the middle, and the reader swaps the middle out whenever it holds a
+// newer snapshot. Neither side ever waits, and the reader always gets the
+// latest snapshot, skipping any it was too slow for.
+
+const size_t INITIAL_ITEMS = 64;
+const size_t INITIAL_VERTICES = 256;
+// set on the middle slot's index while it holds a snapshot not yet read
+const unsigned FRESH = 4;
+
+typedef struct render_snapshot {
+  render_item_t *items;
+  size_t size;
+  size_t capacity;
+  vector_t *vertices;
+  size_t vertex_count;
+  size_t vertex_capacity;
+  size_t time_left;
+  size_t coins;
+} render_snapshot_t;
+
+typedef struct render_buffer {
+  render_snapshot_t *slots[3];
+  // only touched by the writer
+  unsigned back;
+  // only touched by the reader
+  unsigned front;
+  atomic_uint middle;
+  // whether the reader has taken a snapshot yet
+  bool started;
+} render_buffer_t;
+
+render_snapshot_t *render_snapshot_init(void) {
+  render_snapshot_t *out = malloc(sizeof(render_snapshot_t));
+  assert(out != NULL);
+  out->items = malloc(sizeof(render_item_t) * INITIAL_ITEMS);
+  out->vertices = malloc(sizeof(vector_t) * INITIAL_VERTICES);
+  assert(out->items != NULL);
+  assert(out->vertices != NULL);
+  out->size = 0;
+  out->capacity = INITIAL_ITEMS;
+  out->vertex_count = 0;
+  out->vertex_capacity = INITIAL_VERTICES;
+  out->time_left = 0;
+  out->coins = 0;
+  return out;
+}
+
+void render_snapshot_free(render_snapshot_t *snapshot) {
+  free(snapshot->items);
+  free(snapshot->vertices);
+  free(snapshot);
+}
+
+// copies every body in scene; infinite mass bodies are marked static
+void render_snapshot_capture(render_snapshot_t *snapshot, scene_t *scene) {
+  size_t bodies = scene_bodies(scene);
+  if (bodies > snapshot->capacity) {
+    while (snapshot->capacity < bodies) {
+      snapshot->capacity *= 2;
+    }
+    snapshot->items =
+        realloc(snapshot->items, sizeof(render_item_t) * snapshot->capacity);
+    assert(snapshot->items != NULL);
+  }
+  snapshot->size = 0;
+  snapshot->vertex_count = 0;
+  for (size_t i = 0; i < bodies; i++) {
+    body_t *body = scene_get_body(scene, i);
+    size_t count = body_vertex_count(body);
+    if (snapshot->vertex_count + count > snapshot->vertex_capacity) {
+      while (snapshot->vertex_capacity < snapshot->vertex_count + count) {
+        snapshot->vertex_capacity *= 2;
+      }
+      snapshot->vertices = realloc(
+          snapshot->vertices, sizeof(vector_t) * snapshot->vertex_capacity);
+      assert(snapshot->vertices != NULL);
+    }
+    render_item_t *item = &snapshot->items[snapshot->size++];
+    item->centroid = body_get_centroid(body);
+    item->angle = body_get_angle(body);
+    body_get_bounds(body, &item->min, &item->max);
+    item->texture_id = body_get_texture_id(body);
+    item->texture_size = body_get_texture_size(body);
+    item->color = body_get_color(body);
+    item->is_static = body_get_mass(body) == INFINITY;
+    item->first_vertex = snapshot->vertex_count;
+    item->vertex_count = count;
+    body_get_vertices(body, snapshot->vertices + snapshot->vertex_count);
+    snapshot->vertex_count += count;
+  }
+}
+
+void render_snapshot_set_hud(render_snapshot_t *snapshot, size_t time_left,
+                             size_t coins) {
+  snapshot->time_left = time_left;
+  snapshot->coins = coins;
+}
+
+size_t render_snapshot_size(render_snapshot_t *snapshot) {
+  return snapshot->size;
+}
+
+const render_item_t *render_snapshot_get(render_snapshot_t *snapshot,
+                                         size_t index) {
+  assert(index < snapshot->size);
+  return &snapshot->items[index];
+}
+
+const vector_t *render_snapshot_vertices(render_snapshot_t *snapshot,
+                                         const render_item_t *item) {
+  return snapshot->vertices + item->first_vertex;
+}
+
+size_t render_snapshot_time_left(render_snapshot_t *snapshot) {
+  return snapshot->time_left;
+}
+
+size_t render_snapshot_coins(render_snapshot_t *snapshot) {
+  return snapshot->coins;
+}
+
+render_buffer_t *render_buffer_init(void) {
+  render_buffer_t *out = malloc(sizeof(render_buffer_t));
+  assert(out != NULL);
+  for (size_t i = 0; i < 3; i++) {
+    out->slots[i] = render_snapshot_init();
+  }
+  out->back = 0;
+  atomic_init(&out->middle, 1);
+  out->front = 2;
+  out->started = false;
+  return out;
+}
+
+void render_buffer_free(render_buffer_t *buffer) {
+  for (size_t i = 0; i < 3; i++) {
+    render_snapshot_free(buffer->slots[i]);
+  }
+  free(buffer);
+}
+
+// the writer's snapshot to fill before render_buffer_publish()
+render_snapshot_t *render_buffer_back(render_buffer_t *buffer) {
+  return buffer->slots[buffer->back];
+}
+
+void render_buffer_publish(render_buffer_t *buffer) {
+  unsigned old = atomic_exchange_explicit(
+      &buffer->middle, buffer->back | FRESH, memory_order_acq_rel);
+  buffer->back = old & ~FRESH;
+}
+
+// the newest published snapshot, which stays the reader's until the next
+// call; NULL until the writer has published one
+render_snapshot_t *render_buffer_latest(render_buffer_t *buffer) {
+  if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) & FRESH) {
+    unsigned old = atomic_exchange_explicit(&buffer->middle, buffer->front,
+                                            memory_order_acq_rel);
+    buffer->front = old & ~FRESH;
+    buffer->started = true;
+  }
+  return buffer->started ? buffer->slots[buffer->front] : NULL;
+}
@@ -0,0 +1,251 @@
+#include "replay.h"
+#include "scene.h"
+#include "sdl_wrapper.h"
+#include "snapshot.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A replay file is text: a header naming the seed and fixed step, then one
+// line per event, in order.
+//   F <frame> <dt>                  wall time handed to the game that frame
+//   K <tick> <key> <type> <held>    key applied before that fixed step
+//   H <frame> <hash>                scene hash after that frame's step
+// Doubles are written in hex so they round trip exactly. Keys are indexed by
+// fixed step rather than frame, since that's where the game applies them.
+
+const char REPLAY_MAGIC[] = "stalker-replay";
+const int REPLAY_VERSION = 2;
+// frames between state hashes
+const size_t CHECKPOINT_INTERVAL = 60;
+const size_t INITIAL_EVENTS = 256;
+
+typedef struct replay_event {
+  char kind;
+  // frame and hash events are numbered by frame, keys by fixed step
+  size_t frame;
+  size_t tick;
+  char key;
+  key_event_type_t type;
+  double value;
+  uint64_t hash;
+} replay_event_t;
+
+typedef struct replay {
+  bool playing;
+  FILE *file;
+  uint64_t seed;
+  double step;
+  size_t frame;
+  // playback only: every frame and hash event in the file and the next one
+  // to consume, then the keys, which are ordered by tick instead
+  replay_event_t *events;
+  size_t size;
+  size_t capacity;
+  size_t next;
+  replay_event_t *keys;
+  size_t key_count;
+  size_t key_capacity;
+  size_t next_key;
+  size_t last_frame;
+  snapshot_t *snapshot;
+} replay_t;
+
+replay_t *replay_alloc(bool playing, uint64_t seed, double step) {
+  replay_t *out = malloc(sizeof(replay_t));
+  assert(out != NULL);
+  out->playing = playing;
+  out->file = NULL;
+  out->seed = seed;
+  out->step = step;
+  out->frame = 0;
+  out->events = NULL;
+  out->size = 0;
+  out->capacity = 0;
+  out->next = 0;
+  out->keys = NULL;
+  out->key_count = 0;
+  out->key_capacity = 0;
+  out->next_key = 0;
+  out->last_frame = 0;
+  out->snapshot = snapshot_init(4096);
+  return out;
+}
+
+replay_t *replay_record(const char *path, uint64_t seed, double step) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    return NULL;
+  }
+  replay_t *out = replay_alloc(false, seed, step);
+  out->file = file;
+  fprintf(file, "%s %d\nseed %" PRIu64 "\nstep %a\n", REPLAY_MAGIC,
+          REPLAY_VERSION, seed, step);
+  return out;
+}
+
+replay_event_t *append_event(replay_event_t *events, size_t *size,
+                             size_t *capacity, replay_event_t event) {
+  if (*size >= *capacity) {
+    *capacity = *capacity > 0 ? *capacity * 2 : INITIAL_EVENTS;
+    events = realloc(events, sizeof(replay_event_t) * *capacity);
+    assert(events != NULL);
+  }
+  events[(*size)++] = event;
+  return events;
+}
+
+// returns NULL if the file can't be read or isn't a replay of this version
+replay_t *replay_open(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+  char magic[32];
+  int version;
+  uint64_t seed;
+  double step;
+  if (fscanf(file, "%31s %d seed %" SCNu64 " step %la", magic, &version,
+             &seed, &step) != 4 ||
+      strcmp(magic, REPLAY_MAGIC) != 0 || version != REPLAY_VERSION) {
+    fclose(file);
+    return NULL;
+  }
+  replay_t *out = replay_alloc(true, seed, step);
+  char line[128];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    replay_event_t event = {.kind = line[0]};
+    int key;
+    int type;
+    bool valid = false;
+    switch (event.kind) {
+    case 'F':
+      valid = sscanf(line, "F %zu %la", &event.frame, &event.value) == 2;
+      break;
+    case 'K':
+      valid = sscanf(line, "K %zu %d %d %la", &event.tick, &key, &type,
+                     &event.value) == 4;
+      event.key = key;
+      event.type = type;
+      break;
+    case 'H':
+      valid = sscanf(line, "H %zu %" SCNx64, &event.frame, &event.hash) == 2;
+      break;
+    }
+    if (!valid) {
+      continue;
+    }
+    if (event.kind == 'K') {
+      out->keys =
+          append_event(out->keys, &out->key_count, &out->key_capacity, event);
+      continue;
+    }
+    out->events =
+        append_event(out->events, &out->size, &out->capacity, event);
+    if (event.kind == 'F') {
+      out->last_frame = event.frame + 1;
+    }
+  }
+  fclose(file);
+  return out;
+}
+
+void replay_free(replay_t *replay) {
+  if (replay->file != NULL) {
+    fclose(replay->file);
+  }
+  free(replay->events);
+  free(replay->keys);
+  snapshot_free(replay->snapshot);
+  free(replay);
+}
+
+bool replay_is_playing(replay_t *replay) { return replay->playing; }
+
+bool replay_is_finished(replay_t *replay) {
+  return replay->playing && replay->frame >= replay->last_frame;
+}
+
+uint64_t replay_get_seed(replay_t *replay) { return replay->seed; }
+
+double replay_get_step(replay_t *replay) { return replay->step; }
+
+size_t replay_get_frame(replay_t *replay) { return replay->frame; }
+
+void replay_key(replay_t *replay, size_t tick, char key,
+                key_event_type_t type, double held_time) {
+  assert(!replay->playing);
+  fprintf(replay->file, "K %zu %d %d %a\n", tick, key, type, held_time);
+}
+
+// the next unconsumed event of kind for frame, skipping anything left over
+// from earlier frames
+replay_event_t *replay_peek(replay_t *replay, char kind, size_t frame) {
+  while (replay->next < replay->size &&
+         replay->events[replay->next].frame < frame) {
+    replay->next++;
+  }
+  if (replay->next == replay->size) {
+    return NULL;
+  }
+  replay_event_t *event = &replay->events[replay->next];
+  return event->frame == frame && event->kind == kind ? event : NULL;
+}
+
+// the next key recorded for tick, skipping any left over from earlier ticks
+bool replay_next_key(replay_t *replay, size_t tick, char *key,
+                     key_event_type_t *type, double *held_time) {
+  assert(replay->playing);
+  while (replay->next_key < replay->key_count &&
+         replay->keys[replay->next_key].tick < tick) {
+    replay->next_key++;
+  }
+  if (replay->next_key == replay->key_count ||
+      replay->keys[replay->next_key].tick != tick) {
+    return false;
+  }
+  replay_event_t *event = &replay->keys[replay->next_key++];
+  *key = event->key;
+  *type = event->type;
+  *held_time = event->value;
+  return true;
+}
+
+double replay_frame(replay_t *replay, double dt) {
+  if (!replay->playing) {
+    fprintf(replay->file, "F %zu %a\n", replay->frame, dt);
+    return dt;
+  }
+  replay_event_t *event = replay_peek(replay, 'F', replay->frame);
+  if (event == NULL) {
+    return dt;
+  }
+  replay->next++;
+  return event->value;
+}
+
+// hashes the scene every CHECKPOINT_INTERVAL frames, then moves on to the next
+// frame. -1 = the hash differs from the recording, 0 = okay
+int replay_end_frame(replay_t *replay, scene_t *scene,
+                     info_encoder_t encoder) {
+  size_t frame = replay->frame++;
+  if (frame % CHECKPOINT_INTERVAL != CHECKPOINT_INTERVAL - 1) {
+    return 0;
+  }
+  scene_snapshot(scene, replay->snapshot, encoder);
+  uint64_t hash = snapshot_hash(replay->snapshot);
+  if (!replay->playing) {
+    fprintf(replay->file, "H %zu %016" PRIx64 "\n", frame, hash);
+    return 0;
+  }
+  replay_event_t *event = replay_peek(replay, 'H', frame);
+  if (event == NULL) {
+    return 0;
+  }
+  replay->next++;
+  return event->hash == hash ? 0 : -1;
+}
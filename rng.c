@@ -0,0 +1,123 @@
+#include "rng.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// xoshiro256** by Blackman and Vigna; 256 bits of state, period 2^256 - 1
+typedef struct rng {
+  uint64_t state[4];
+} rng_t;
+
+// jump polynomial advancing the state by 2^128 draws
+const uint64_t JUMP[4] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
+                          0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+
+uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+// splitmix64 spreads a single seed word over the full state
+uint64_t splitmix_next(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+void rng_seed(rng_t *rng, uint64_t seed) {
+  for (size_t i = 0; i < 4; i++) {
+    rng->state[i] = splitmix_next(&seed);
+  }
+}
+
+rng_t *rng_init(uint64_t seed) {
+  rng_t *out = malloc(sizeof(rng_t));
+  assert(out != NULL);
+  rng_seed(out, seed);
+  return out;
+}
+
+void rng_free(rng_t *rng) { free(rng); }
+
+void rng_get_state(rng_t *rng, uint64_t state[4]) {
+  for (size_t i = 0; i < 4; i++) {
+    state[i] = rng->state[i];
+  }
+}
+
+void rng_set_state(rng_t *rng, const uint64_t state[4]) {
+  for (size_t i = 0; i < 4; i++) {
+    rng->state[i] = state[i];
+  }
+}
+
+uint64_t rng_next(rng_t *rng) {
+  uint64_t *s = rng->state;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+// uniform in [0, 1) from the top 53 bits
+double rng_double(rng_t *rng) {
+  return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+// uniform in [0, bound) without the bias of a plain modulo; draws below the
+// threshold would favour small results, so they are redrawn
+uint64_t rng_range(rng_t *rng, uint64_t bound) {
+  assert(bound > 0);
+  uint64_t threshold = -bound % bound;
+  while (true) {
+    uint64_t r = rng_next(rng);
+    if (r >= threshold) {
+      return r % bound;
+    }
+  }
+}
+
+void rng_fill_doubles(rng_t *rng, double *out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = rng_double(rng);
+  }
+}
+
+void rng_fill_range(rng_t *rng, uint64_t bound, uint64_t *out,
+                    size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = rng_range(rng, bound);
+  }
+}
+
+void rng_jump(rng_t *rng) {
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (size_t i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (JUMP[i] & ((uint64_t)1 << b)) {
+        s0 ^= rng->state[0];
+        s1 ^= rng->state[1];
+        s2 ^= rng->state[2];
+        s3 ^= rng->state[3];
+      }
+      rng_next(rng);
+    }
+  }
+  rng->state[0] = s0;
+  rng->state[1] = s1;
+  rng->state[2] = s2;
+  rng->state[3] = s3;
+}
+
+// the child takes the current stream and the parent jumps 2^128 draws ahead,
+// so the two never overlap
+rng_t *rng_split(rng_t *rng) {
+  rng_t *out = malloc(sizeof(rng_t));
+  assert(out != NULL);
+  *out = *rng;
+  rng_jump(rng);
+  return out;
+}
@@ -1,50 +1,530 @@
 #include "scene.h"
 #include "body.h"
 #include "forces.h"
+#include "geometry.h"
 #include "list.h"
+#include "profiler.h"
+#include "rng.h"
 #include "sdl_wrapper.h"
+#include "snapshot.h"
+#include "trace.h"
 #include <assert.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 const size_t REASONABLE_GUESS = 30;
+// scenes are reproducible out of the box; callers reseed with scene_seed
+const uint64_t DEFAULT_SEED = 3;
+
+// dynamic aabb tree constants
+// how far each leaf box is fattened past the body's tight bounds, so that
+// small movements don't force a reinsert every tick
+const double AABB_MARGIN = 10;
+const size_t NULL_NODE = (size_t)-1;
+#define QUERY_STACK_SIZE 256
+// priority reported for bodies added without a lifetime; they are never
+// despawned or evicted
+const int PERSISTENT_PRIORITY = -1;
+
+typedef struct aabb {
+  vector_t min;
+  vector_t max;
+} aabb_t;
+
+// a node is either a leaf holding a body or an internal node whose box
+// encloses both children; freed nodes are chained through parent
+typedef struct tree_node {
+  aabb_t box;
+  body_t *body;
+  size_t parent;
+  size_t left;
+  size_t right;
+  int height;
+} tree_node_t;
+
+// snapshot format; all offsets are from the start of the snapshot, so it can
+// be written to disk and mapped back at any address
+const uint32_t SNAPSHOT_MAGIC = 0x314b5453;
+const uint32_t SNAPSHOT_VERSION = 2;
+const uint32_t NO_INDEX = UINT32_MAX;
+// records are written on 8 byte boundaries; see snapshot.c
+const uint64_t SNAPSHOT_ALIGN = 8;
+
+typedef struct snapshot_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t body_count;
+  uint32_t force_count;
+  uint32_t geometry_count;
+  uint32_t string_count;
+  uint64_t bodies;
+  uint64_t forces;
+  uint64_t geometries;
+  uint64_t strings;
+  double time;
+  uint64_t rng[4];
+  uint32_t despawn_enabled;
+  uint32_t padding;
+  vector_t area_min;
+  vector_t area_max;
+  double margin;
+  uint64_t max_population;
+} snapshot_header_t;
+
+// bodies refer to geometry, texture and info by index; NO_INDEX means none
+typedef struct body_record {
+  vector_t centroid;
+  vector_t velocity;
+  vector_t force;
+  vector_t impulse;
+  double angle;
+  double mass;
+  double born;
+  double ttl;
+  uint64_t coins;
+  rgb_color_t color;
+  uint32_t geometry;
+  uint32_t texture;
+  uint32_t info;
+  int32_t priority;
+  uint32_t removed;
+} body_record_t;
+
+typedef struct geometry_record {
+  uint64_t vertices;
+  uint64_t size;
+} geometry_record_t;
+
+typedef struct string_record {
+  uint64_t offset;
+  uint64_t length;
+} string_record_t;
+
+// forces refer to their bodies by index into the body records
+typedef struct force_record {
+  uint32_t kind;
+  uint32_t body1;
+  uint32_t body2;
+  uint32_t collided;
+  double constant;
+} force_record_t;
+
+// scratch entry for deduplicating and looking up pointers while writing
+typedef struct pointer_index {
+  const void *pointer;
+  uint32_t index;
+} pointer_index_t;
+
+// per-body bookkeeping kept alongside the body list; slots[i] belongs to
+// scene_get_body(scene, i)
+typedef struct body_slot {
+  size_t proxy;
+  double born;
+  double ttl;
+  int priority;
+} body_slot_t;
+
+// used to rank eviction candidates when the population cap is exceeded
+typedef struct eviction_candidate {
+  size_t index;
+  double born;
+  int priority;
+} eviction_candidate_t;
 
 typedef struct scene {
   list_t *bodies;
   list_t *forces;
+  tree_node_t *nodes;
+  size_t node_capacity;
+  size_t free_node;
+  size_t root;
+  body_slot_t *slots;
+  size_t slot_capacity;
+  double time;
+  rng_t *rng;
+  // despawn policy; bodies whose centroid leaves [area_min, area_max] grown
+  // by margin are removed, as are the lowest priority, oldest bodies once
+  // more than max_population have a lifetime
+  bool despawn_enabled;
+  vector_t area_min;
+  vector_t area_max;
+  double margin;
+  size_t max_population;
+  eviction_candidate_t *candidates;
+  size_t candidate_capacity;
+  pointer_index_t *scratch;
+  // per-body geometry and texture ids while writing a snapshot
+  uint32_t *geometry_ids;
+  uint32_t *texture_ids;
+  size_t scratch_capacity;
+  // texture paths owned by a restored scene
+  list_t *strings;
 } scene_t;
 
 typedef void (*force_creator_t)(void *aux);
+typedef uint32_t (*info_encoder_t)(void *info);
+typedef void *(*info_decoder_t)(uint32_t tag);
 
 void void_body_free2(void *p) { body_free(p); }
 
+aabb_t aabb_union(aabb_t a, aabb_t b) {
+  return (aabb_t){.min = {.x = fmin(a.min.x, b.min.x),
+                          .y = fmin(a.min.y, b.min.y)},
+                  .max = {.x = fmax(a.max.x, b.max.x),
+                          .y = fmax(a.max.y, b.max.y)}};
+}
+
+double aabb_perimeter(aabb_t a) {
+  return 2 * ((a.max.x - a.min.x) + (a.max.y - a.min.y));
+}
+
+bool aabb_contains(aabb_t outer, aabb_t inner) {
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y &&
+         inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+
+bool aabb_overlaps(aabb_t a, aabb_t b) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y &&
+         b.min.y <= a.max.y;
+}
+
+// squared distance from a point to the closest point of a box
+double aabb_distance_squared(aabb_t a, vector_t point) {
+  double dx = fmax(fmax(a.min.x - point.x, 0), point.x - a.max.x);
+  double dy = fmax(fmax(a.min.y - point.y, 0), point.y - a.max.y);
+  return dx * dx + dy * dy;
+}
+
+// slab test; returns the entry distance along the ray, or INFINITY on a miss
+double aabb_ray_distance(aabb_t a, vector_t origin, vector_t inv_dir,
+                         double max_distance) {
+  double t_min = 0;
+  double t_max = max_distance;
+  double origins[2] = {origin.x, origin.y};
+  double invs[2] = {inv_dir.x, inv_dir.y};
+  double mins[2] = {a.min.x, a.min.y};
+  double maxs[2] = {a.max.x, a.max.y};
+  for (size_t axis = 0; axis < 2; axis++) {
+    double t1 = (mins[axis] - origins[axis]) * invs[axis];
+    double t2 = (maxs[axis] - origins[axis]) * invs[axis];
+    // a zero direction component gives nan when the origin sits on a slab
+    if (isnan(t1) || isnan(t2)) {
+      continue;
+    }
+    t_min = fmax(t_min, fmin(t1, t2));
+    t_max = fmin(t_max, fmax(t1, t2));
+  }
+  return t_min <= t_max ? t_min : INFINITY;
+}
+
+aabb_t body_aabb(body_t *body) {
+  aabb_t out;
+  body_get_bounds(body, &out.min, &out.max);
+  return out;
+}
+
+aabb_t aabb_fatten(aabb_t a) {
+  vector_t margin = {.x = AABB_MARGIN, .y = AABB_MARGIN};
+  return (aabb_t){.min = vec_subtract(a.min, margin),
+                  .max = vec_add(a.max, margin)};
+}
+
+size_t tree_allocate_node(scene_t *scene) {
+  if (scene->free_node == NULL_NODE) {
+    size_t old_capacity = scene->node_capacity;
+    scene->node_capacity = old_capacity * 2;
+    scene->nodes =
+        realloc(scene->nodes, sizeof(tree_node_t) * scene->node_capacity);
+    assert(scene->nodes != NULL);
+    for (size_t i = old_capacity; i < scene->node_capacity; i++) {
+      scene->nodes[i].parent =
+          i + 1 < scene->node_capacity ? i + 1 : NULL_NODE;
+      scene->nodes[i].height = -1;
+    }
+    scene->free_node = old_capacity;
+  }
+  size_t node = scene->free_node;
+  scene->free_node = scene->nodes[node].parent;
+  scene->nodes[node].parent = NULL_NODE;
+  scene->nodes[node].left = NULL_NODE;
+  scene->nodes[node].right = NULL_NODE;
+  scene->nodes[node].body = NULL;
+  scene->nodes[node].height = 0;
+  return node;
+}
+
+void tree_free_node(scene_t *scene, size_t node) {
+  scene->nodes[node].parent = scene->free_node;
+  scene->nodes[node].height = -1;
+  scene->free_node = node;
+}
+
+// rotates the subtree at a up if it is imbalanced, returning its new root
+size_t tree_balance(scene_t *scene, size_t a) {
+  tree_node_t *nodes = scene->nodes;
+  if (nodes[a].left == NULL_NODE || nodes[a].height < 2) {
+    return a;
+  }
+  size_t b = nodes[a].left;
+  size_t c = nodes[a].right;
+  int balance = nodes[c].height - nodes[b].height;
+  if (balance > -2 && balance < 2) {
+    return a;
+  }
+  // promote the taller child; its taller grandchild stays beneath it and
+  // the shorter one moves over to a
+  size_t up = balance > 0 ? c : b;
+  size_t other = balance > 0 ? b : c;
+  size_t f = nodes[up].left;
+  size_t g = nodes[up].right;
+  size_t keep = nodes[f].height > nodes[g].height ? f : g;
+  size_t move = keep == f ? g : f;
+
+  nodes[up].left = a;
+  nodes[up].right = keep;
+  nodes[up].parent = nodes[a].parent;
+  nodes[a].parent = up;
+  if (nodes[up].parent != NULL_NODE) {
+    tree_node_t *parent = &nodes[nodes[up].parent];
+    if (parent->left == a) {
+      parent->left = up;
+    } else {
+      parent->right = up;
+    }
+  } else {
+    scene->root = up;
+  }
+
+  nodes[a].left = other;
+  nodes[a].right = move;
+  nodes[move].parent = a;
+  nodes[a].box = aabb_union(nodes[other].box, nodes[move].box);
+  nodes[up].box = aabb_union(nodes[a].box, nodes[keep].box);
+  nodes[a].height = 1 + (nodes[other].height > nodes[move].height
+                             ? nodes[other].height
+                             : nodes[move].height);
+  nodes[up].height = 1 + (nodes[a].height > nodes[keep].height
+                              ? nodes[a].height
+                              : nodes[keep].height);
+  return up;
+}
+
+// walks from node to the root, refitting boxes and heights
+void tree_refit_ancestors(scene_t *scene, size_t node) {
+  while (node != NULL_NODE) {
+    node = tree_balance(scene, node);
+    tree_node_t *curr = &scene->nodes[node];
+    tree_node_t *left = &scene->nodes[curr->left];
+    tree_node_t *right = &scene->nodes[curr->right];
+    curr->height =
+        1 + (left->height > right->height ? left->height : right->height);
+    curr->box = aabb_union(left->box, right->box);
+    node = curr->parent;
+  }
+}
+
+void tree_insert_leaf(scene_t *scene, size_t leaf) {
+  tree_node_t *nodes;
+  if (scene->root == NULL_NODE) {
+    scene->root = leaf;
+    scene->nodes[leaf].parent = NULL_NODE;
+    return;
+  }
+
+  // descend towards the sibling that grows the total perimeter the least
+  aabb_t leaf_box = scene->nodes[leaf].box;
+  size_t index = scene->root;
+  while (scene->nodes[index].left != NULL_NODE) {
+    nodes = scene->nodes;
+    size_t left = nodes[index].left;
+    size_t right = nodes[index].right;
+    double perimeter = aabb_perimeter(nodes[index].box);
+    double combined = aabb_perimeter(aabb_union(nodes[index].box, leaf_box));
+    double cost = 2 * combined;
+    double inheritance = 2 * (combined - perimeter);
+
+    double cost_left = aabb_perimeter(aabb_union(leaf_box, nodes[left].box)) +
+                       inheritance;
+    if (nodes[left].left != NULL_NODE) {
+      cost_left -= aabb_perimeter(nodes[left].box);
+    }
+    double cost_right =
+        aabb_perimeter(aabb_union(leaf_box, nodes[right].box)) + inheritance;
+    if (nodes[right].left != NULL_NODE) {
+      cost_right -= aabb_perimeter(nodes[right].box);
+    }
+
+    if (cost < cost_left && cost < cost_right) {
+      break;
+    }
+    index = cost_left < cost_right ? left : right;
+  }
+
+  size_t sibling = index;
+  size_t new_parent = tree_allocate_node(scene);
+  nodes = scene->nodes;
+  size_t old_parent = nodes[sibling].parent;
+  nodes[new_parent].parent = old_parent;
+  nodes[new_parent].box = aabb_union(leaf_box, nodes[sibling].box);
+  nodes[new_parent].height = nodes[sibling].height + 1;
+  nodes[new_parent].left = sibling;
+  nodes[new_parent].right = leaf;
+  nodes[sibling].parent = new_parent;
+  nodes[leaf].parent = new_parent;
+  if (old_parent == NULL_NODE) {
+    scene->root = new_parent;
+  } else if (nodes[old_parent].left == sibling) {
+    nodes[old_parent].left = new_parent;
+  } else {
+    nodes[old_parent].right = new_parent;
+  }
+  tree_refit_ancestors(scene, old_parent);
+}
+
+void tree_remove_leaf(scene_t *scene, size_t leaf) {
+  tree_node_t *nodes = scene->nodes;
+  if (leaf == scene->root) {
+    scene->root = NULL_NODE;
+    return;
+  }
+  size_t parent = nodes[leaf].parent;
+  size_t grand_parent = nodes[parent].parent;
+  size_t sibling =
+      nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+  if (grand_parent == NULL_NODE) {
+    scene->root = sibling;
+    nodes[sibling].parent = NULL_NODE;
+  } else {
+    if (nodes[grand_parent].left == parent) {
+      nodes[grand_parent].left = sibling;
+    } else {
+      nodes[grand_parent].right = sibling;
+    }
+    nodes[sibling].parent = grand_parent;
+  }
+  tree_free_node(scene, parent);
+  tree_refit_ancestors(scene, grand_parent);
+}
+
+size_t tree_create_proxy(scene_t *scene, body_t *body) {
+  size_t leaf = tree_allocate_node(scene);
+  scene->nodes[leaf].box = aabb_fatten(body_aabb(body));
+  scene->nodes[leaf].body = body;
+  tree_insert_leaf(scene, leaf);
+  return leaf;
+}
+
+void tree_destroy_proxy(scene_t *scene, size_t leaf) {
+  tree_remove_leaf(scene, leaf);
+  tree_free_node(scene, leaf);
+}
+
+// reinserts the leaf only once the body has left its fattened box
+void tree_move_proxy(scene_t *scene, size_t leaf) {
+  aabb_t tight = body_aabb(scene->nodes[leaf].body);
+  if (aabb_contains(scene->nodes[leaf].box, tight)) {
+    return;
+  }
+  tree_remove_leaf(scene, leaf);
+  scene->nodes[leaf].box = aabb_fatten(tight);
+  tree_insert_leaf(scene, leaf);
+}
+
 scene_t *scene_init(void) {
   scene_t *scene = malloc(sizeof(scene_t));
   assert(scene != NULL);
   scene->bodies = list_init(REASONABLE_GUESS, (free_func_t)body_free);
   scene->forces = list_init(REASONABLE_GUESS, (free_func_t)force_free);
+  scene->node_capacity = REASONABLE_GUESS * 2;
+  scene->nodes = malloc(sizeof(tree_node_t) * scene->node_capacity);
+  assert(scene->nodes != NULL);
+  for (size_t i = 0; i < scene->node_capacity; i++) {
+    scene->nodes[i].parent = i + 1 < scene->node_capacity ? i + 1 : NULL_NODE;
+    scene->nodes[i].height = -1;
+  }
+  scene->free_node = 0;
+  scene->root = NULL_NODE;
+  scene->slot_capacity = REASONABLE_GUESS;
+  scene->slots = malloc(sizeof(body_slot_t) * scene->slot_capacity);
+  assert(scene->slots != NULL);
+  scene->time = 0;
+  scene->rng = rng_init(DEFAULT_SEED);
+  scene->despawn_enabled = false;
+  scene->max_population = (size_t)-1;
+  scene->candidate_capacity = 0;
+  scene->candidates = NULL;
+  scene->scratch_capacity = 0;
+  scene->scratch = NULL;
+  scene->geometry_ids = NULL;
+  scene->texture_ids = NULL;
+  scene->strings = list_init(1, free);
   return scene;
 }
 
 void scene_free(scene_t *scene) {
   list_free(scene->bodies);
   list_free(scene->forces);
+  free(scene->nodes);
+  free(scene->slots);
+  free(scene->candidates);
+  free(scene->scratch);
+  free(scene->geometry_ids);
+  free(scene->texture_ids);
+  list_free(scene->strings);
+  rng_free(scene->rng);
 
   free(scene);
 }
 
 size_t scene_bodies(scene_t *scene) { return list_size(scene->bodies); }
 
+size_t scene_forces(scene_t *scene) { return list_size(scene->forces); }
+
 body_t *scene_get_body(scene_t *scene, size_t index) {
   return list_get(scene->bodies, index);
 }
 
 list_t *scene_get_bodies(scene_t *scene) { return scene->bodies; }
 
-void scene_add_body(scene_t *scene, body_t *body) {
+void scene_add_body_with_lifetime(scene_t *scene, body_t *body, double ttl,
+                                  int priority) {
+  size_t index = list_size(scene->bodies);
+  if (index >= scene->slot_capacity) {
+    scene->slot_capacity = scene->slot_capacity * 2 + 1;
+    scene->slots =
+        realloc(scene->slots, sizeof(body_slot_t) * scene->slot_capacity);
+    assert(scene->slots != NULL);
+  }
   list_add(scene->bodies, body);
+  scene->slots[index].proxy = tree_create_proxy(scene, body);
+  scene->slots[index].born = scene->time;
+  scene->slots[index].ttl = ttl;
+  scene->slots[index].priority = priority;
+}
+
+void scene_add_body(scene_t *scene, body_t *body) {
+  scene_add_body_with_lifetime(scene, body, INFINITY, PERSISTENT_PRIORITY);
+}
+
+void scene_set_despawn_policy(scene_t *scene, vector_t area_min,
+                              vector_t area_max, double margin,
+                              size_t max_population) {
+  scene->despawn_enabled = true;
+  scene->area_min = area_min;
+  scene->area_max = area_max;
+  scene->margin = margin;
+  scene->max_population = max_population;
 }
 
+double scene_get_time(scene_t *scene) { return scene->time; }
+
+void scene_seed(scene_t *scene, uint64_t seed) { rng_seed(scene->rng, seed); }
+
+rng_t *scene_get_rng(scene_t *scene) { return scene->rng; }
+
 void scene_remove_body(scene_t *scene, size_t index) {
   assert(index < scene_bodies(scene));
   body_remove(scene_get_body(scene, index));
@@ -63,19 +543,192 @@ void scene_add_force_creator(scene_t *scene, force_creator_t forcer, void *aux,
   scene_add_bodies_force_creator(scene, forcer, aux, bodies, freer);
 }
 
+void scene_query_aabb(scene_t *scene, vector_t min, vector_t max,
+                      scene_query_handler_t handler, void *aux) {
+  if (scene->root == NULL_NODE) {
+    return;
+  }
+  aabb_t query = {.min = min, .max = max};
+  size_t stack[QUERY_STACK_SIZE];
+  size_t count = 0;
+  stack[count++] = scene->root;
+  while (count > 0) {
+    tree_node_t *node = &scene->nodes[stack[--count]];
+    if (!aabb_overlaps(node->box, query)) {
+      continue;
+    }
+    if (node->left == NULL_NODE) {
+      if (aabb_overlaps(body_aabb(node->body), query) &&
+          !handler(node->body, aux)) {
+        return;
+      }
+      continue;
+    }
+    assert(count + 2 <= QUERY_STACK_SIZE);
+    stack[count++] = node->left;
+    stack[count++] = node->right;
+  }
+}
+
+void scene_query_radius(scene_t *scene, vector_t center, double radius,
+                        scene_query_handler_t handler, void *aux) {
+  if (scene->root == NULL_NODE) {
+    return;
+  }
+  double radius_squared = radius * radius;
+  size_t stack[QUERY_STACK_SIZE];
+  size_t count = 0;
+  stack[count++] = scene->root;
+  while (count > 0) {
+    tree_node_t *node = &scene->nodes[stack[--count]];
+    if (aabb_distance_squared(node->box, center) > radius_squared) {
+      continue;
+    }
+    if (node->left == NULL_NODE) {
+      if (aabb_distance_squared(body_aabb(node->body), center) <=
+              radius_squared &&
+          !handler(node->body, aux)) {
+        return;
+      }
+      continue;
+    }
+    assert(count + 2 <= QUERY_STACK_SIZE);
+    stack[count++] = node->left;
+    stack[count++] = node->right;
+  }
+}
+
+void scene_raycast(scene_t *scene, vector_t origin, vector_t direction,
+                   double max_distance, scene_raycast_handler_t handler,
+                   void *aux) {
+  double length = sqrt(vec_dot(direction, direction));
+  if (scene->root == NULL_NODE || length == 0) {
+    return;
+  }
+  vector_t unit = vec_multiply(1 / length, direction);
+  vector_t inv_dir = {.x = 1 / unit.x, .y = 1 / unit.y};
+  size_t stack[QUERY_STACK_SIZE];
+  size_t count = 0;
+  stack[count++] = scene->root;
+  while (count > 0) {
+    tree_node_t *node = &scene->nodes[stack[--count]];
+    if (aabb_ray_distance(node->box, origin, inv_dir, max_distance) ==
+        INFINITY) {
+      continue;
+    }
+    if (node->left == NULL_NODE) {
+      double distance = aabb_ray_distance(body_aabb(node->body), origin,
+                                          inv_dir, max_distance);
+      if (distance != INFINITY && !handler(node->body, distance, aux)) {
+        return;
+      }
+      continue;
+    }
+    assert(count + 2 <= QUERY_STACK_SIZE);
+    stack[count++] = node->left;
+    stack[count++] = node->right;
+  }
+}
+
+int eviction_compare(const void *a, const void *b) {
+  const eviction_candidate_t *first = a;
+  const eviction_candidate_t *second = b;
+  if (first->priority != second->priority) {
+    return first->priority < second->priority ? -1 : 1;
+  }
+  if (first->born != second->born) {
+    return first->born < second->born ? -1 : 1;
+  }
+  return 0;
+}
+
+// marks expired, strayed and surplus bodies as removed; only bodies added
+// with a lifetime are considered, and surplus ones go lowest priority first,
+// oldest first within a priority
+void scene_despawn(scene_t *scene) {
+  size_t population = 0;
+  vector_t margin = {.x = scene->margin, .y = scene->margin};
+  vector_t min = vec_subtract(scene->area_min, margin);
+  vector_t max = vec_add(scene->area_max, margin);
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    body_slot_t *slot = &scene->slots[i];
+    body_t *body = scene_get_body(scene, i);
+    if (slot->priority == PERSISTENT_PRIORITY || body_is_removed(body)) {
+      continue;
+    }
+    vector_t center = body_get_centroid(body);
+    if (scene->time - slot->born >= slot->ttl || center.x < min.x ||
+        center.y < min.y || center.x > max.x || center.y > max.y) {
+      body_remove(body);
+      continue;
+    }
+    population++;
+  }
+  if (population <= scene->max_population) {
+    return;
+  }
+
+  if (population > scene->candidate_capacity) {
+    scene->candidate_capacity = population * 2;
+    scene->candidates =
+        realloc(scene->candidates,
+                sizeof(eviction_candidate_t) * scene->candidate_capacity);
+    assert(scene->candidates != NULL);
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    body_slot_t *slot = &scene->slots[i];
+    if (slot->priority == PERSISTENT_PRIORITY ||
+        body_is_removed(scene_get_body(scene, i))) {
+      continue;
+    }
+    scene->candidates[count++] = (eviction_candidate_t){
+        .index = i, .born = slot->born, .priority = slot->priority};
+  }
+  qsort(scene->candidates, count, sizeof(eviction_candidate_t),
+        eviction_compare);
+  for (size_t i = 0; i < population - scene->max_population; i++) {
+    body_remove(scene_get_body(scene, scene->candidates[i].index));
+  }
+}
+
 void scene_tick(scene_t *scene, double dt) {
   list_t *forces_list = scene->forces;
+  profiler_count(COUNT_TICKS, 1);
+  profiler_set(COUNT_BODIES, scene_bodies(scene));
+  profiler_set(COUNT_FORCES, list_size(forces_list));
 
+  profiler_begin(PROFILE_FORCES);
+  // naming a force takes a lookup, so only do it while tracing
+  bool traced = trace_is_enabled();
   for (size_t d = 0; d < list_size(forces_list); d++) {
     force_t *curr_force = (force_t *)list_get(forces_list, d);
+    const char *name = traced ? force_get_name(curr_force) : NULL;
+    if (name != NULL) {
+      trace_begin(name);
+    }
     curr_force->forcer(curr_force->aux);
+    if (name != NULL) {
+      trace_end(name);
+    }
   }
+  profiler_end(PROFILE_FORCES);
 
+  profiler_begin(PROFILE_INTEGRATE);
   for (size_t i = 0; i < scene_bodies(scene); i++) {
     body_t *curr_body = scene_get_body(scene, i);
     body_tick(curr_body, dt);
+    tree_move_proxy(scene, scene->slots[i].proxy);
+  }
+  profiler_end(PROFILE_INTEGRATE);
+  scene->time += dt;
+  if (scene->despawn_enabled) {
+    profiler_begin(PROFILE_DESPAWN);
+    scene_despawn(scene);
+    profiler_end(PROFILE_DESPAWN);
   }
 
+  profiler_begin(PROFILE_REMOVE);
   for (size_t f = 0; f < list_size(forces_list); f++) {
     force_t *curr_force = (force_t *)list_get(forces_list, f);
     list_t *bodies = curr_force->bodies;
@@ -93,10 +746,367 @@ void scene_tick(scene_t *scene, double dt) {
   for (size_t b = 0; b < scene_bodies(scene); b++) {
     body_t *curr = scene_get_body(scene, b);
     if (body_is_removed(curr)) {
+      tree_destroy_proxy(scene, scene->slots[b].proxy);
+      for (size_t p = b + 1; p < scene_bodies(scene); p++) {
+        scene->slots[p - 1] = scene->slots[p];
+      }
       list_remove(bodies_scene, b);
       body_free(curr);
       b--;
     }
   }
+  profiler_end(PROFILE_REMOVE);
 }
 
+int pointer_index_compare(const void *a, const void *b) {
+  uintptr_t first = (uintptr_t)((const pointer_index_t *)a)->pointer;
+  uintptr_t second = (uintptr_t)((const pointer_index_t *)b)->pointer;
+  return first < second ? -1 : first > second;
+}
+
+// always allocates, so qsort and bsearch never see a null base even for an
+// empty scene
+void scene_reserve_scratch(scene_t *scene, size_t count) {
+  if (count > scene->scratch_capacity || scene->scratch == NULL) {
+    scene->scratch_capacity = count > 0 ? count * 2 : 1;
+    scene->scratch = realloc(scene->scratch, sizeof(pointer_index_t) *
+                                                 scene->scratch_capacity);
+    scene->geometry_ids = realloc(
+        scene->geometry_ids, sizeof(uint32_t) * scene->scratch_capacity);
+    scene->texture_ids = realloc(scene->texture_ids,
+                                 sizeof(uint32_t) * scene->scratch_capacity);
+    assert(scene->scratch != NULL);
+    assert(scene->geometry_ids != NULL && scene->texture_ids != NULL);
+  }
+}
+
+// ties are broken by index so each run of equal pointers starts at the body
+// that holds it first
+int pointer_index_order(const void *a, const void *b) {
+  int by_pointer = pointer_index_compare(a, b);
+  if (by_pointer != 0) {
+    return by_pointer;
+  }
+  uint32_t first = ((const pointer_index_t *)a)->index;
+  uint32_t second = ((const pointer_index_t *)b)->index;
+  return first < second ? -1 : first > second;
+}
+
+// numbers the distinct non-null pointers in scratch in order of first
+// appearance, writing each entry's id to ids[entry.index]
+size_t scene_number_pointers(scene_t *scene, size_t count, uint32_t *ids) {
+  qsort(scene->scratch, count, sizeof(pointer_index_t), pointer_index_order);
+  for (size_t i = 0; i < count; i++) {
+    pointer_index_t *entry = &scene->scratch[i];
+    if (entry->pointer == NULL) {
+      ids[entry->index] = NO_INDEX;
+    } else if (i > 0 && entry->pointer == scene->scratch[i - 1].pointer) {
+      ids[entry->index] = ids[scene->scratch[i - 1].index];
+    } else {
+      ids[entry->index] = entry->index;
+    }
+  }
+  // ids now name the first body sharing each pointer; renumber them densely
+  size_t unique = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (ids[i] == NO_INDEX) {
+      continue;
+    }
+    ids[i] = ids[i] == i ? unique++ : ids[ids[i]];
+  }
+  return unique;
+}
+
+uint32_t scene_lookup_body(scene_t *scene, body_t *body) {
+  pointer_index_t key = {.pointer = body};
+  pointer_index_t *found =
+      bsearch(&key, scene->scratch, scene_bodies(scene),
+              sizeof(pointer_index_t), pointer_index_compare);
+  assert(found != NULL);
+  return found->index;
+}
+
+// writes a self-contained copy of the scene into out, replacing its contents.
+// Geometry and texture paths shared between bodies are stored once, info is
+// stored as whatever tag encoder returns (encoder may be NULL to drop it),
+// and every force must be one of the kinds created through forces.c.
+void scene_snapshot(scene_t *scene, snapshot_t *out, info_encoder_t encoder) {
+  snapshot_clear(out);
+  size_t body_count = scene_bodies(scene);
+  size_t header_offset = snapshot_reserve(out, sizeof(snapshot_header_t));
+  size_t bodies_offset =
+      snapshot_reserve(out, sizeof(body_record_t) * body_count);
+  scene_reserve_scratch(scene, body_count);
+
+  for (size_t i = 0; i < body_count; i++) {
+    body_t *body = scene_get_body(scene, i);
+    body_slot_t *slot = &scene->slots[i];
+    body_record_t *record =
+        (body_record_t *)snapshot_at(out, bodies_offset) + i;
+    *record = (body_record_t){
+        .centroid = body_get_centroid(body),
+        .velocity = body_get_velocity(body),
+        .force = body_get_force(body),
+        .impulse = body_get_impulse(body),
+        .angle = body_get_angle(body),
+        .mass = body_get_mass(body),
+        .born = slot->born,
+        .ttl = slot->ttl,
+        .coins = body_get_coins(body),
+        .color = body_get_color(body),
+        .info = encoder != NULL && body_get_info(body) != NULL
+                    ? encoder(body_get_info(body))
+                    : NO_INDEX,
+        .priority = slot->priority,
+        .removed = body_is_removed(body)};
+    scene->scratch[i] =
+        (pointer_index_t){.pointer = body_get_geometry(body), .index = i};
+  }
+  size_t geometry_count =
+      scene_number_pointers(scene, body_count, scene->geometry_ids);
+  for (size_t i = 0; i < body_count; i++) {
+    scene->scratch[i] = (pointer_index_t){
+        .pointer = body_get_texture(scene_get_body(scene, i)), .index = i};
+  }
+  size_t string_count =
+      scene_number_pointers(scene, body_count, scene->texture_ids);
+
+  size_t geometries_offset =
+      snapshot_reserve(out, sizeof(geometry_record_t) * geometry_count);
+  size_t strings_offset =
+      snapshot_reserve(out, sizeof(string_record_t) * string_count);
+  size_t next_geometry = 0;
+  size_t next_string = 0;
+  for (size_t i = 0; i < body_count; i++) {
+    body_t *body = scene_get_body(scene, i);
+    uint32_t geometry = scene->geometry_ids[i];
+    uint32_t texture = scene->texture_ids[i];
+    body_record_t *record =
+        (body_record_t *)snapshot_at(out, bodies_offset) + i;
+    record->geometry = geometry;
+    record->texture = texture;
+    // ids are handed out in body order, so each one is new exactly when it
+    // reaches the next unwritten id
+    if (geometry >= next_geometry) {
+      geometry_t *shape = body_get_geometry(body);
+      size_t size = geometry_size(shape);
+      size_t vertices = snapshot_reserve(out, sizeof(vector_t) * size);
+      memcpy(snapshot_at(out, vertices), geometry_get_vertices(shape),
+             sizeof(vector_t) * size);
+      geometry_record_t *geometry_record =
+          (geometry_record_t *)snapshot_at(out, geometries_offset) + geometry;
+      *geometry_record =
+          (geometry_record_t){.vertices = vertices, .size = size};
+      next_geometry = geometry + 1;
+    }
+    if (texture != NO_INDEX && texture >= next_string) {
+      char *link = body_get_texture(body);
+      size_t length = strlen(link);
+      size_t offset = snapshot_reserve(out, length + 1);
+      memcpy(snapshot_at(out, offset), link, length + 1);
+      string_record_t *string_record =
+          (string_record_t *)snapshot_at(out, strings_offset) + texture;
+      *string_record = (string_record_t){.offset = offset, .length = length};
+      next_string = texture + 1;
+    }
+  }
+
+  for (size_t i = 0; i < body_count; i++) {
+    scene->scratch[i] =
+        (pointer_index_t){.pointer = scene_get_body(scene, i), .index = i};
+  }
+  qsort(scene->scratch, body_count, sizeof(pointer_index_t),
+        pointer_index_compare);
+  size_t force_count = list_size(scene->forces);
+  size_t forces_offset =
+      snapshot_reserve(out, sizeof(force_record_t) * force_count);
+  for (size_t f = 0; f < force_count; f++) {
+    force_t *force = list_get(scene->forces, f);
+    force_record_t *record =
+        (force_record_t *)snapshot_at(out, forces_offset) + f;
+    double constant;
+    bool collided;
+    bool encoded = force_encode(force, &record->kind, &constant, &collided);
+    assert(encoded);
+    size_t bodies = list_size(force->bodies);
+    assert(bodies == 1 || bodies == 2);
+    record->constant = constant;
+    record->collided = collided;
+    record->body1 = scene_lookup_body(scene, list_get(force->bodies, 0));
+    record->body2 = bodies == 2
+                        ? scene_lookup_body(scene, list_get(force->bodies, 1))
+                        : NO_INDEX;
+  }
+
+  snapshot_header_t *header = snapshot_at(out, header_offset);
+  *header = (snapshot_header_t){.magic = SNAPSHOT_MAGIC,
+                                .version = SNAPSHOT_VERSION,
+                                .body_count = body_count,
+                                .force_count = force_count,
+                                .geometry_count = geometry_count,
+                                .string_count = string_count,
+                                .bodies = bodies_offset,
+                                .forces = forces_offset,
+                                .geometries = geometries_offset,
+                                .strings = strings_offset,
+                                .time = scene->time,
+                                .despawn_enabled = scene->despawn_enabled,
+                                .area_min = scene->area_min,
+                                .area_max = scene->area_max,
+                                .margin = scene->margin,
+                                .max_population = scene->max_population};
+  rng_get_state(scene->rng, header->rng);
+}
+
+// whether count records of record_size bytes fit in size bytes at offset,
+// aligned so they can be read in place
+bool snapshot_fits(uint64_t offset, uint64_t count, size_t record_size,
+                   size_t size) {
+  return offset % SNAPSHOT_ALIGN == 0 && offset <= size &&
+         count <= (size - offset) / record_size;
+}
+
+// checks every count, index and offset a snapshot of size bytes holds, so a
+// truncated or corrupt file is rejected rather than read out of bounds
+bool snapshot_is_valid(const uint8_t *bytes, size_t size) {
+  if (size < sizeof(snapshot_header_t)) {
+    return false;
+  }
+  const snapshot_header_t *header = (const snapshot_header_t *)bytes;
+  if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+      !snapshot_fits(header->bodies, header->body_count,
+                     sizeof(body_record_t), size) ||
+      !snapshot_fits(header->forces, header->force_count,
+                     sizeof(force_record_t), size) ||
+      !snapshot_fits(header->geometries, header->geometry_count,
+                     sizeof(geometry_record_t), size) ||
+      !snapshot_fits(header->strings, header->string_count,
+                     sizeof(string_record_t), size)) {
+    return false;
+  }
+  const geometry_record_t *geometries =
+      (const geometry_record_t *)(bytes + header->geometries);
+  for (size_t g = 0; g < header->geometry_count; g++) {
+    if (geometries[g].size == 0 ||
+        !snapshot_fits(geometries[g].vertices, geometries[g].size,
+                       sizeof(vector_t), size)) {
+      return false;
+    }
+  }
+  const string_record_t *strings =
+      (const string_record_t *)(bytes + header->strings);
+  for (size_t t = 0; t < header->string_count; t++) {
+    // the terminator has to be inside the file too
+    if (strings[t].offset > size ||
+        strings[t].length >= size - strings[t].offset ||
+        bytes[strings[t].offset + strings[t].length] != '\0') {
+      return false;
+    }
+  }
+  const body_record_t *bodies = (const body_record_t *)(bytes + header->bodies);
+  for (size_t i = 0; i < header->body_count; i++) {
+    if (bodies[i].geometry >= header->geometry_count ||
+        (bodies[i].texture != NO_INDEX &&
+         bodies[i].texture >= header->string_count)) {
+      return false;
+    }
+  }
+  const force_record_t *forces =
+      (const force_record_t *)(bytes + header->forces);
+  for (size_t f = 0; f < header->force_count; f++) {
+    // a one-body force has no second body at all
+    size_t acting = force_kind_bodies(forces[f].kind);
+    if (acting == 0 || forces[f].body1 >= header->body_count ||
+        (acting == 2 ? forces[f].body2 >= header->body_count
+                     : forces[f].body2 != NO_INDEX)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// builds a new scene from a snapshot without modifying it, so data may point
+// into a mapped file. decoder turns info tags back into info freed with
+// info_freer; tags are dropped when it is NULL. Returns NULL if data isn't a
+// valid snapshot of this version.
+scene_t *scene_restore(const void *data, size_t size, info_decoder_t decoder,
+                       free_func_t info_freer) {
+  const uint8_t *bytes = data;
+  if (!snapshot_is_valid(bytes, size)) {
+    return NULL;
+  }
+  const snapshot_header_t *header = data;
+
+  scene_t *scene = scene_init();
+  scene->time = header->time;
+  rng_set_state(scene->rng, header->rng);
+  if (header->despawn_enabled) {
+    scene_set_despawn_policy(scene, header->area_min, header->area_max,
+                             header->margin, header->max_population);
+  }
+
+  const geometry_record_t *geometry_records =
+      (const geometry_record_t *)(bytes + header->geometries);
+  geometry_t **geometries =
+      malloc(sizeof(geometry_t *) * (header->geometry_count + 1));
+  assert(geometries != NULL);
+  for (size_t g = 0; g < header->geometry_count; g++) {
+    geometries[g] = geometry_init_local(
+        (const vector_t *)(bytes + geometry_records[g].vertices),
+        geometry_records[g].size);
+  }
+  const string_record_t *string_records =
+      (const string_record_t *)(bytes + header->strings);
+  size_t first_string = list_size(scene->strings);
+  for (size_t t = 0; t < header->string_count; t++) {
+    char *link = malloc(string_records[t].length + 1);
+    assert(link != NULL);
+    memcpy(link, bytes + string_records[t].offset,
+           string_records[t].length + 1);
+    list_add(scene->strings, link);
+  }
+
+  const body_record_t *bodies = (const body_record_t *)(bytes + header->bodies);
+  for (size_t i = 0; i < header->body_count; i++) {
+    const body_record_t *record = &bodies[i];
+    void *info = decoder != NULL && record->info != NO_INDEX
+                     ? decoder(record->info)
+                     : NULL;
+    char *link = record->texture != NO_INDEX
+                     ? list_get(scene->strings, first_string + record->texture)
+                     : NULL;
+    body_t *body = body_init_with_geometry(geometries[record->geometry],
+                                           record->mass, record->color, info,
+                                           info != NULL ? info_freer : NULL,
+                                           link);
+    body_set_centroid(body, record->centroid);
+    body_set_velocity(body, record->velocity);
+    body_set_rotation(body, record->angle);
+    body_add_force(body, record->force);
+    body_add_impulse(body, record->impulse);
+    body_set_coin_count(body, record->coins);
+    if (record->removed) {
+      body_remove(body);
+    }
+    scene_add_body_with_lifetime(scene, body, record->ttl, record->priority);
+    scene->slots[i].born = record->born;
+  }
+  for (size_t g = 0; g < header->geometry_count; g++) {
+    geometry_release(geometries[g]);
+  }
+  free(geometries);
+
+  const force_record_t *forces =
+      (const force_record_t *)(bytes + header->forces);
+  for (size_t f = 0; f < header->force_count; f++) {
+    const force_record_t *record = &forces[f];
+    body_t *body1 = scene_get_body(scene, record->body1);
+    body_t *body2 = force_kind_bodies(record->kind) == 2
+                        ? scene_get_body(scene, record->body2)
+                        : NULL;
+    force_decode(scene, record->kind, body1, body2, record->constant);
+    force_set_collided(list_get(scene->forces, list_size(scene->forces) - 1),
+                       record->collided);
+  }
+  return scene;
+}
@@ -0,0 +1,118 @@
+#include "scheduler.h"
+#include "rng.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// a spawner fires as a poisson process; due is the simulation time of its
+// next arrival
+typedef struct spawn_event {
+  double due;
+  double rate;
+  spawner_t spawner;
+  void *aux;
+} spawn_event_t;
+
+// binary min-heap of events keyed on due; arrival gaps come from a stream
+// split off the rng passed to scheduler_init
+typedef struct scheduler {
+  spawn_event_t *heap;
+  size_t size;
+  size_t capacity;
+  rng_t *rng;
+} scheduler_t;
+
+scheduler_t *scheduler_init(size_t initial_size, rng_t *rng) {
+  scheduler_t *out = malloc(sizeof(scheduler_t));
+  assert(out != NULL);
+  out->rng = rng_split(rng);
+  out->size = 0;
+  out->capacity = initial_size > 0 ? initial_size : 1;
+  out->heap = malloc(sizeof(spawn_event_t) * out->capacity);
+  assert(out->heap != NULL);
+  return out;
+}
+
+void scheduler_free(scheduler_t *scheduler) {
+  rng_free(scheduler->rng);
+  free(scheduler->heap);
+  free(scheduler);
+}
+
+// draws an exponentially distributed gap between arrivals
+double scheduler_interval(scheduler_t *scheduler, double rate) {
+  return -log(1 - rng_double(scheduler->rng)) / rate;
+}
+
+void scheduler_swap(scheduler_t *scheduler, size_t a, size_t b) {
+  spawn_event_t temp = scheduler->heap[a];
+  scheduler->heap[a] = scheduler->heap[b];
+  scheduler->heap[b] = temp;
+}
+
+void scheduler_sift_up(scheduler_t *scheduler, size_t index) {
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (scheduler->heap[parent].due <= scheduler->heap[index].due) {
+      return;
+    }
+    scheduler_swap(scheduler, parent, index);
+    index = parent;
+  }
+}
+
+void scheduler_sift_down(scheduler_t *scheduler, size_t index) {
+  while (true) {
+    size_t smallest = index;
+    size_t left = 2 * index + 1;
+    size_t right = left + 1;
+    if (left < scheduler->size &&
+        scheduler->heap[left].due < scheduler->heap[smallest].due) {
+      smallest = left;
+    }
+    if (right < scheduler->size &&
+        scheduler->heap[right].due < scheduler->heap[smallest].due) {
+      smallest = right;
+    }
+    if (smallest == index) {
+      return;
+    }
+    scheduler_swap(scheduler, smallest, index);
+    index = smallest;
+  }
+}
+
+void scheduler_add(scheduler_t *scheduler, double rate, double now,
+                   spawner_t spawner, void *aux) {
+  assert(rate > 0);
+  if (scheduler->size >= scheduler->capacity) {
+    scheduler->capacity *= 2;
+    scheduler->heap =
+        realloc(scheduler->heap, sizeof(spawn_event_t) * scheduler->capacity);
+    assert(scheduler->heap != NULL);
+  }
+  scheduler->heap[scheduler->size] =
+      (spawn_event_t){.due = now + scheduler_interval(scheduler, rate),
+                      .rate = rate,
+                      .spawner = spawner,
+                      .aux = aux};
+  scheduler->size++;
+  scheduler_sift_up(scheduler, scheduler->size - 1);
+}
+
+double scheduler_next_due(scheduler_t *scheduler) {
+  return scheduler->size > 0 ? scheduler->heap[0].due : INFINITY;
+}
+
+// fires every event due by now in time order; each one is rescheduled from
+// its own due time so arrivals stay poisson however coarse the steps are
+void scheduler_advance(scheduler_t *scheduler, double now) {
+  while (scheduler->size > 0 && scheduler->heap[0].due <= now) {
+    spawn_event_t *next = &scheduler->heap[0];
+    spawner_t spawner = next->spawner;
+    void *aux = next->aux;
+    next->due += scheduler_interval(scheduler, next->rate);
+    scheduler_sift_down(scheduler, 0);
+    spawner(aux);
+  }
+}
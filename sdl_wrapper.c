@@ -1,7 +1,12 @@
 #include "sdl_wrapper.h"
+#include "alloc.h"
 #include "list.h"
+#include "loader.h"
+#include "profiler.h"
+#include "render_snapshot.h"
 #include "scene.h"
 #include "state.h"
+#include "texture.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL2_gfxPrimitives.h>
 #include <SDL2/SDL_ttf.h>
@@ -22,6 +27,8 @@ const double MS_PER_S = 1e3;
 const size_t FREQUENCY = 44100; // default for music sampling
 const size_t STEREO = 2;
 const size_t CHUNK_SIZE = 4096; // about 100ms
+// sound effects share this many mixer channels; music streams separately
+#define SFX_VOICES 8
 
 /**
  * The coordinate at the center of the screen.
@@ -53,19 +60,196 @@ uint32_t key_start_timestamp;
  * Initially 0.
  */
 clock_t last_clock = 0;
-list_t *textures;
-list_t *music_tracks;
-list_t *sound_effects;
+// sprites no bigger than this are packed into the sprite atlas
+const int SPRITE_ATLAS_WIDTH = 512;
+const int SPRITE_ATLAS_MAX_SIZE = 128;
+// gap between packed sprites so filtering doesn't bleed between them
+const int SPRITE_PADDING = 1;
+
+typedef struct sprite {
+  // NULL until loaded; shared by every sprite packed into the same atlas
+  SDL_Texture *texture;
+  // in the manifest but not loaded yet
+  bool pending;
+  // will be packed into the atlas once every atlas sprite is decoded
+  bool packed;
+  SDL_FPoint uv_min;
+  SDL_FPoint uv_max;
+} sprite_t;
+
+/**
+ * Loaded sprites indexed by texture id.
+ */
+sprite_t *sprites = NULL;
+size_t sprites_size = 0;
+
+typedef struct draw_command {
+  // commands are only reordered within a segment; see sdl_queue_sprite()
+  size_t segment;
+  // NULL for solid polygons
+  SDL_Texture *texture;
+  size_t sequence;
+  size_t first_index;
+  size_t index_count;
+} draw_command_t;
+
+/**
+ * Draws queued since the frame began. Vertices and indices for every command
+ * share one buffer each; the buffers are kept between frames so a steady
+ * frame doesn't allocate.
+ */
+draw_command_t *commands = NULL;
+size_t command_count = 0;
+size_t command_capacity = 0;
+SDL_Vertex *vertices = NULL;
+size_t vertex_count = 0;
+size_t vertex_capacity = 0;
+int *indices = NULL;
+size_t index_count = 0;
+size_t index_capacity = 0;
+// indices of one flush, gathered in sorted command order
+int *batch = NULL;
+size_t batch_capacity = 0;
+size_t segment = 0;
+
+// HUD text
+const int HUD_FONT_SIZE = 24;
+const int HUD_ATLAS_WIDTH = 512;
+// glyphs in the atlas: printable ASCII
+const char HUD_FIRST_GLYPH = ' ';
+const char HUD_LAST_GLYPH = '~';
+#define HUD_GLYPHS ('~' - ' ' + 1)
+#define HUD_LABEL_LENGTH 31
+
+typedef struct hud_label {
+  const char *format;
+  // pixels the text is stretched over
+  SDL_Rect rect;
+  size_t value;
+  bool built;
+  size_t glyphs;
+  SDL_Vertex quads[4 * HUD_LABEL_LENGTH];
+} hud_label_t;
+
+/**
+ * Every HUD glyph rendered once into one texture, and where each one is.
+ */
+SDL_Texture *hud_atlas = NULL;
+SDL_Rect hud_glyph_rects[HUD_GLYPHS];
+int hud_atlas_width = 0;
+int hud_atlas_height = 0;
+int hud_font_height = 0;
+/**
+ * A font's glyph atlas as a loader thread builds it, before the render
+ * thread adopts it.
+ */
+typedef struct hud_font {
+  SDL_Surface *atlas;
+  SDL_Rect glyph_rects[HUD_GLYPHS];
+  int atlas_width;
+  int atlas_height;
+  int font_height;
+} hud_font_t;
+hud_label_t time_label = {.format = "%zu seconds",
+                          .rect = {.x = 5, .y = 0, .w = 250, .h = 50}};
+hud_label_t coins_label = {.format = "%zu coins",
+                           .rect = {.x = 5, .y = 60, .w = 250, .h = 50}};
+
+/**
+ * The window center for this frame, read once in sdl_clear().
+ */
+vector_t frame_center;
+/**
+ * The part of the scene the window shows this frame, in scene coordinates.
+ */
+vector_t view_min;
+vector_t view_max;
+/**
+ * What sdl_render_scene() draws from, reused every frame.
+ */
+render_snapshot_t *scene_capture = NULL;
+/**
+ * Scratch space for a body's outline, kept between draws.
+ */
+vector_t *outline = NULL;
+size_t outline_capacity = 0;
+
+/**
+ * Bodies that never move, composited once into a window-sized texture that
+ * is copied each frame, and what they looked like when it was drawn.
+ */
+SDL_Texture *static_layer = NULL;
+uint64_t static_signature = 0;
+int static_width = 0;
+int static_height = 0;
+// set when the renderer lost the layer's contents
+bool static_lost = false;
+// indices of the items drawn into the layer
+size_t *static_bodies = NULL;
+size_t static_capacity = 0;
+
+// outlines with more vertices than this are thinned when drawn small
+const size_t LOD_MIN_VERTICES = 8;
+// about how many pixels of perimeter each drawn vertex should cover
+const double LOD_PIXELS_PER_VERTEX = 6;
+
+// ASSETS
+const char ASSET_MANIFEST[] = "assets/manifest.txt";
+const size_t LOADER_THREADS = 2;
+
+typedef struct sfx_entry {
+  // manifest name
+  const char *name;
+  // a sound only takes a busy voice from one of the same or lower priority
+  int priority;
+  // stops every other sound, and the music, when played
+  bool exclusive;
+} sfx_entry_t;
+
+const sfx_entry_t SFX_TABLE[NUM_SFX] = {
+    [SFX_DASH] = {.name = "dash", .priority = 0, .exclusive = false},
+    [SFX_VICTORY] = {.name = "victory", .priority = 1, .exclusive = true},
+    [SFX_DEFEAT] = {.name = "defeat", .priority = 1, .exclusive = true}};
+
+/**
+ * Loads the manifest's assets in the background, or NULL once all are in.
+ */
+loader_t *assets = NULL;
+/**
+ * Decoded atlas sprites waiting for the rest, and how many are still out.
+ */
+typedef struct atlas_slot {
+  size_t id;
+  SDL_Surface *surface;
+  // whether the surface was decoded; it's freed once it's been packed
+  bool decoded;
+  SDL_Rect rect;
+} atlas_slot_t;
+atlas_slot_t *atlas_slots = NULL;
+size_t atlas_slot_count = 0;
+size_t atlas_waiting = 0;
+/**
+ * Music is streamed from disk as it plays rather than decoded up front.
+ */
+Mix_Music *music_track = NULL;
+Mix_Chunk *sound_effects[NUM_SFX];
+/**
+ * What each voice last played and when, for choosing one to take over.
+ */
+int voice_priority[SFX_VOICES];
+uint64_t voice_started[SFX_VOICES];
+uint64_t sfx_played = 0;
 
 /** Computes the center of the window in pixel coordinates */
 vector_t get_window_center(void) {
-  int *width = malloc(sizeof(*width)), *height = malloc(sizeof(*height));
+  int *width = tracked_malloc(sizeof(*width), ALLOC_RENDER),
+      *height = tracked_malloc(sizeof(*height), ALLOC_RENDER);
   assert(width != NULL);
   assert(height != NULL);
   SDL_GetWindowSize(window, width, height);
   vector_t dimensions = {.x = *width, .y = *height};
-  free(width);
-  free(height);
+  tracked_free(width);
+  tracked_free(height);
   return vec_multiply(0.5, dimensions);
 }
 
@@ -125,6 +309,58 @@ char get_keycode(SDL_Keycode key) {
   }
 }
 
+// glyphs outside the atlas are drawn as spaces
+SDL_Rect *hud_glyph(char c) {
+  if (c < HUD_FIRST_GLYPH || c > HUD_LAST_GLYPH) {
+    c = ' ';
+  }
+  return &hud_glyph_rects[c - HUD_FIRST_GLYPH];
+}
+
+// renders each HUD glyph once into rows of an atlas surface. Runs on a
+// loader thread, so the layout goes back with the surface and the render
+// thread copies it out in sdl_pump_assets().
+hud_font_t *hud_build_atlas(const char *path) {
+  TTF_Font *font = TTF_OpenFont(path, HUD_FONT_SIZE);
+  if (font == NULL) {
+    return NULL;
+  }
+  hud_font_t *out = tracked_malloc(sizeof(hud_font_t), ALLOC_RENDER);
+  assert(out != NULL);
+  SDL_Color white = {255, 255, 255, 255};
+  int font_height = TTF_FontHeight(font);
+  SDL_Surface *glyphs[HUD_GLYPHS];
+  int x = 0, y = 0;
+  for (size_t i = 0; i < HUD_GLYPHS; i++) {
+    glyphs[i] = TTF_RenderGlyph_Blended(font, HUD_FIRST_GLYPH + i, white);
+    int width = glyphs[i] != NULL ? glyphs[i]->w : 0;
+    if (x + width > HUD_ATLAS_WIDTH) {
+      x = 0;
+      y += font_height;
+    }
+    out->glyph_rects[i] =
+        (SDL_Rect){.x = x, .y = y, .w = width, .h = font_height};
+    x += width;
+  }
+  TTF_CloseFont(font);
+  out->font_height = font_height;
+  out->atlas_width = HUD_ATLAS_WIDTH;
+  out->atlas_height = y + font_height;
+  out->atlas = SDL_CreateRGBSurfaceWithFormat(
+      0, out->atlas_width, out->atlas_height, 32, SDL_PIXELFORMAT_RGBA32);
+  assert(out->atlas != NULL);
+  for (size_t i = 0; i < HUD_GLYPHS; i++) {
+    if (glyphs[i] == NULL) {
+      continue;
+    }
+    // copy the glyph's alpha rather than blending onto the empty atlas
+    SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(glyphs[i], NULL, out->atlas, &out->glyph_rects[i]);
+    SDL_FreeSurface(glyphs[i]);
+  }
+  return out;
+}
+
 void sdl_init(vector_t min, vector_t max) {
   TTF_Init();
   // Check parameters
@@ -136,53 +372,23 @@ void sdl_init(vector_t min, vector_t max) {
   window = SDL_CreateWindow(WINDOW_TITLE, SDL_WINDOWPOS_CENTERED,
                             SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT,
                             SDL_WINDOW_RESIZABLE);
-  renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
-  textures = list_init(2600, (free_func_t)(free));
-  SDL_Texture *texture_bounce = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/bounce_obstacle_1.png"));
-  SDL_Texture *texture_coin = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/coin.png"));
-  SDL_Texture *texture_player = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/player_down.png"));
-  SDL_Texture *texture_stalker = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/stalker_up.png"));
-  SDL_Texture *texture_vel = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/bounce_obstacle_2.png"));
-  SDL_Texture *texture_power = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/bounce_obstacle_3.png"));
-  SDL_Texture *texture_background = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/purple_background.png"));
-  SDL_Texture *texture_win = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/victory_screen.jpeg"));
-  SDL_Texture *texture_loose = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/game_over_screen.jpeg"));
-  list_add(textures, texture_bounce);
-  list_add(textures, texture_coin);
-  list_add(textures, texture_player);
-  list_add(textures, texture_stalker);
-  list_add(textures, texture_vel);
-  list_add(textures, texture_power);
-  list_add(textures, texture_background);
-  list_add(textures, texture_win);
-  list_add(textures, texture_loose);
-
-  // initialize SDL
+  renderer = SDL_CreateRenderer(
+      window, -1, SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
+
+  // initialize SDL; sounds are decoded for this format, so the device has
+  // to be open before sdl_load_assets()
   SDL_Init(SDL_INIT_AUDIO);
   Mix_OpenAudio(FREQUENCY, MIX_DEFAULT_FORMAT, STEREO, CHUNK_SIZE);
-  // music
-  Mix_Chunk *normal_music = Mix_LoadWAV("assets/Space_Search.wav");
-  assert(normal_music != NULL);
-  music_tracks = list_init(1, (free_func_t)(Mix_FreeChunk));
-  list_add(music_tracks, normal_music);
-
-  // sfx
-  Mix_Chunk *dash = Mix_LoadWAV("assets/Pharah_DUPE_1.wav");
-  Mix_Chunk *victory = Mix_LoadWAV("assets/Hooray.wav");
-  Mix_Chunk *defeat = Mix_LoadWAV("assets/gg_go_next.wav");
-  sound_effects = list_init(3, (free_func_t)(Mix_FreeChunk));
-  list_add(sound_effects, dash);
-  list_add(sound_effects, victory);
-  list_add(sound_effects, defeat);
+  Mix_AllocateChannels(SFX_VOICES);
 }
 
+// the key handler only queues keys; the game applies them between steps
 bool sdl_is_done(state_t *state) {
-  SDL_Event *event = malloc(sizeof(*event));
-  assert(event != NULL);
+  SDL_Event event_storage;
+  SDL_Event *event = &event_storage;
   while (SDL_PollEvent(event)) {
     switch (event->type) {
     case SDL_QUIT:
-      free(event);
       return true;
     case SDL_KEYDOWN:
     case SDL_KEYUP:
@@ -203,240 +409,759 @@ bool sdl_is_done(state_t *state) {
       double held_time = (timestamp - key_start_timestamp) / MS_PER_S;
       key_handler(key, type, held_time, state);
       break;
+    case SDL_RENDER_TARGETS_RESET:
+      static_lost = true;
+      break;
     }
   }
-  free(event);
   return false;
 }
 
+// grows a buffer of elements of the given size to hold at least needed
+void *reserve(void *buffer, size_t *capacity, size_t needed, size_t size) {
+  if (needed <= *capacity) {
+    return buffer;
+  }
+  size_t grown = *capacity > 0 ? *capacity * 2 : 256;
+  while (grown < needed) {
+    grown *= 2;
+  }
+  buffer = tracked_realloc(buffer, grown * size, ALLOC_RENDER);
+  assert(buffer != NULL);
+  *capacity = grown;
+  return buffer;
+}
+
+// reserves count vertices and index_count indices for a new command and
+// returns its first vertex
+size_t queue_command(SDL_Texture *texture, size_t count, size_t added) {
+  commands = reserve(commands, &command_capacity, command_count + 1,
+                     sizeof(draw_command_t));
+  vertices = reserve(vertices, &vertex_capacity, vertex_count + count,
+                     sizeof(SDL_Vertex));
+  indices =
+      reserve(indices, &index_capacity, index_count + added, sizeof(int));
+  commands[command_count] = (draw_command_t){.segment = segment,
+                                             .texture = texture,
+                                             .sequence = command_count,
+                                             .first_index = index_count,
+                                             .index_count = added};
+  command_count++;
+  index_count += added;
+  size_t first = vertex_count;
+  vertex_count += count;
+  return first;
+}
+
 void sdl_clear(void) {
   SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
   SDL_RenderClear(renderer);
+  frame_center = get_window_center();
+  vector_t view_half =
+      vec_multiply(1 / get_scene_scale(frame_center), frame_center);
+  view_min = vec_subtract(center, view_half);
+  view_max = vec_add(center, view_half);
+  sdl_pump_assets();
+  command_count = 0;
+  vertex_count = 0;
+  index_count = 0;
+  segment = 0;
 }
 
-void sdl_draw_polygon(list_t *points, rgb_color_t color) {
+// points are in scene coordinates; the polygon is drawn as a triangle fan,
+// so it must be convex
+void queue_polygon(const vector_t *points, size_t n, rgb_color_t color) {
   // Check parameters
-  size_t n = list_size(points);
   assert(n >= 3);
   assert(0 <= color.r && color.r <= 1);
   assert(0 <= color.g && color.g <= 1);
   assert(0 <= color.b && color.b <= 1);
 
-  vector_t window_center = get_window_center();
+  size_t first = queue_command(NULL, n, 3 * (n - 2));
+  SDL_Color vertex_color = {.r = color.r * 255,
+                            .g = color.g * 255,
+                            .b = color.b * 255,
+                            .a = 255};
+  for (size_t i = 0; i < n; i++) {
+    vector_t pixel = get_window_position(points[i], frame_center);
+    vertices[first + i] = (SDL_Vertex){
+        .position = {.x = pixel.x, .y = pixel.y}, .color = vertex_color};
+  }
+  int *fan = indices + index_count - 3 * (n - 2);
+  for (size_t i = 1; i + 1 < n; i++) {
+    fan[3 * (i - 1)] = first;
+    fan[3 * (i - 1) + 1] = first + i;
+    fan[3 * (i - 1) + 2] = first + i + 1;
+  }
+}
 
-  // Convert each vertex to a point on screen
-  int16_t *x_points = malloc(sizeof(*x_points) * n),
-          *y_points = malloc(sizeof(*y_points) * n);
-  assert(x_points != NULL);
-  assert(y_points != NULL);
+void sdl_draw_polygon(list_t *points, rgb_color_t color) {
+  size_t n = list_size(points);
+  outline = reserve(outline, &outline_capacity, n, sizeof(vector_t));
   for (size_t i = 0; i < n; i++) {
-    vector_t *vertex = list_get(points, i);
-    vector_t pixel = get_window_position(*vertex, window_center);
-    x_points[i] = pixel.x;
-    y_points[i] = pixel.y;
+    outline[i] = *(vector_t *)list_get(points, i);
+  }
+  queue_polygon(outline, n, color);
+}
+
+// how many of a body's n vertices to step over so a smooth outline about
+// pixels across keeps roughly LOD_PIXELS_PER_VERTEX pixels per edge.
+// Keeping every k-th vertex of a convex polygon leaves it convex.
+size_t lod_stride(size_t n, double pixels) {
+  if (n <= LOD_MIN_VERTICES) {
+    return 1;
   }
+  size_t wanted = ceil(M_PI * pixels / LOD_PIXELS_PER_VERTEX);
+  if (wanted < LOD_MIN_VERTICES) {
+    wanted = LOD_MIN_VERTICES;
+  }
+  return wanted >= n ? 1 : n / wanted;
+}
 
-  // Draw polygon with the given color
-  filledPolygonRGBA(renderer, x_points, y_points, n, color.r * 255,
-                    color.g * 255, color.b * 255, 255);
-  free(x_points);
-  free(y_points);
+// queues item's outline through the scratch buffer, thinned if it's small
+// on screen
+void queue_outline(render_snapshot_t *snapshot, const render_item_t *item) {
+  size_t n = item->vertex_count;
+  double extent =
+      fmax(item->max.x - item->min.x, item->max.y - item->min.y);
+  size_t stride = lod_stride(n, extent * get_scene_scale(frame_center));
+  outline = reserve(outline, &outline_capacity, n, sizeof(vector_t));
+  const vector_t *points = render_snapshot_vertices(snapshot, item);
+  size_t drawn = 0;
+  for (size_t i = 0; i < n; i += stride) {
+    outline[drawn++] = points[i];
+  }
+  queue_polygon(outline, drawn, item->color);
 }
 
-void sdl_show(void) {
-  // Draw boundary lines
-  vector_t window_center = get_window_center();
+// queues quads given as four vertices each, corners in order
+void queue_quads(SDL_Texture *texture, const SDL_Vertex *quad_vertices,
+                 size_t quads) {
+  size_t first = queue_command(texture, 4 * quads, 6 * quads);
+  memcpy(vertices + first, quad_vertices, sizeof(SDL_Vertex) * 4 * quads);
+  int *out = indices + index_count - 6 * quads;
+  for (size_t q = 0; q < quads; q++) {
+    int corner = first + 4 * q;
+    int quad[] = {corner, corner + 1, corner + 2,
+                  corner, corner + 2, corner + 3};
+    memcpy(out + 6 * q, quad, sizeof(quad));
+  }
+}
+
+// the four vertices drawing the part of a texture at uv (in [0, 1]) to rect
+void make_quad(SDL_Vertex *out, SDL_Rect rect, SDL_FPoint uv_min,
+               SDL_FPoint uv_max) {
+  SDL_Color white = {.r = 255, .g = 255, .b = 255, .a = 255};
+  float left = rect.x, top = rect.y, right = rect.x + rect.w,
+        bottom = rect.y + rect.h;
+  out[0] = (SDL_Vertex){.position = {left, top},
+                        .color = white,
+                        .tex_coord = {uv_min.x, uv_min.y}};
+  out[1] = (SDL_Vertex){.position = {right, top},
+                        .color = white,
+                        .tex_coord = {uv_max.x, uv_min.y}};
+  out[2] = (SDL_Vertex){.position = {right, bottom},
+                        .color = white,
+                        .tex_coord = {uv_max.x, uv_max.y}};
+  out[3] = (SDL_Vertex){.position = {left, bottom},
+                        .color = white,
+                        .tex_coord = {uv_min.x, uv_max.y}};
+}
+
+// rect is in pixels. Draws are sorted by texture within a segment but never
+// moved across one, and a texture covering the window gets a segment of its
+// own so nothing is sorted to the wrong side of a background.
+void sdl_queue_sprite(sprite_t *sprite, SDL_Rect rect) {
+  bool barrier = rect.w >= WINDOW_WIDTH - 1 && rect.h >= WINDOW_HEIGHT - 1;
+  segment += barrier;
+  SDL_Vertex quad[4];
+  make_quad(quad, rect, sprite->uv_min, sprite->uv_max);
+  queue_quads(sprite->texture, quad, 1);
+  segment += barrier;
+}
+
+int command_compare(const void *a, const void *b) {
+  const draw_command_t *first = a, *second = b;
+  if (first->segment != second->segment) {
+    return first->segment < second->segment ? -1 : 1;
+  }
+  uintptr_t first_texture = (uintptr_t)first->texture,
+            second_texture = (uintptr_t)second->texture;
+  if (first_texture != second_texture) {
+    return first_texture < second_texture ? -1 : 1;
+  }
+  return first->sequence < second->sequence ? -1 : 1;
+}
+
+// submits everything queued with one SDL_RenderGeometry call per texture run
+void sdl_flush(void) {
+  if (command_count == 0) {
+    return;
+  }
+  qsort(commands, command_count, sizeof(draw_command_t), command_compare);
+  batch = reserve(batch, &batch_capacity, index_count, sizeof(int));
+  size_t start = 0;
+  while (start < command_count) {
+    size_t end = start;
+    size_t batched = 0;
+    while (end < command_count &&
+           commands[end].segment == commands[start].segment &&
+           commands[end].texture == commands[start].texture) {
+      memcpy(batch + batched, indices + commands[end].first_index,
+             sizeof(int) * commands[end].index_count);
+      batched += commands[end].index_count;
+      end++;
+    }
+    SDL_RenderGeometry(renderer, commands[start].texture, vertices,
+                       vertex_count, batch, batched);
+    start = end;
+  }
+  command_count = 0;
+  vertex_count = 0;
+  index_count = 0;
+}
+
+void draw_boundary(void) {
   vector_t max = vec_add(center, max_diff),
            min = vec_subtract(center, max_diff);
-  vector_t max_pixel = get_window_position(max, window_center),
-           min_pixel = get_window_position(min, window_center);
-  SDL_Rect *boundary = malloc(sizeof(*boundary));
-  boundary->x = min_pixel.x;
-  boundary->y = max_pixel.y;
-  boundary->w = max_pixel.x - min_pixel.x;
-  boundary->h = min_pixel.y - max_pixel.y;
+  vector_t max_pixel = get_window_position(max, frame_center),
+           min_pixel = get_window_position(min, frame_center);
+  SDL_Rect boundary = {.x = min_pixel.x,
+                       .y = max_pixel.y,
+                       .w = max_pixel.x - min_pixel.x,
+                       .h = min_pixel.y - max_pixel.y};
   SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-  SDL_RenderDrawRect(renderer, boundary);
-  free(boundary);
+  SDL_RenderDrawRect(renderer, &boundary);
+}
 
+// flushes the frame's draws and presents it; call once per frame
+void sdl_show(void) {
+  sdl_flush();
+  // without a scene the boundary isn't part of a static layer
+  if (static_layer == NULL) {
+    draw_boundary();
+  }
   SDL_RenderPresent(renderer);
 }
 
-void make_textures_list(scene_t *scene) {
-  for (size_t i = 0; i < scene_bodies(scene); i++) {
-    body_t *curr = scene_get_body(scene, i);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, IMG_Load(body_get_texture(curr)));
-    list_add(textures, texture);
+void grow_sprites(size_t size) {
+  if (size <= sprites_size) {
+    return;
+  }
+  sprites = tracked_realloc(sprites, sizeof(sprite_t) * size, ALLOC_RENDER);
+  assert(sprites != NULL);
+  for (size_t i = sprites_size; i < size; i++) {
+    sprites[i] = (sprite_t){.texture = NULL};
   }
+  sprites_size = size;
 }
- 
-void sdl_render_scene(scene_t *scene) {
-  sdl_clear();
-  // iterate over bodies; 
-  for (size_t i = 0; i < scene_bodies(scene); i++) {
-    body_t *curr = scene_get_body(scene,i);
-    if (body_get_texture(curr) != NULL) {
-      char* file = body_get_texture(curr);
-      vector_t center = body_get_centroid(curr);
-      SDL_Texture *texture;
-      if (strcmp(file, "assets/bounce_obstacle_1.png") == 0) {
-          texture = list_get(textures, 0);
-      }
-      else if (strcmp(file, "assets/coin.png") == 0) {
-        texture = list_get(textures, 1);
-      }
-      else if (strcmp(file, "assets/player_down.png") == 0) {
-        texture = list_get(textures, 2);
-      }
-      else if (strcmp(file, "assets/stalker_up.png") == 0) {
-        texture = list_get(textures, 3);
-      }  
-      else if (strcmp(file, "assets/bounce_obstacle_2.png") == 0) {
-        texture = list_get(textures, 4);
-      }
-      else if (strcmp(file, "assets/bounce_obstacle_3.png") == 0) {
-        texture = list_get(textures, 5);
-      }
-      else if (strcmp(file, "assets/purple_background.png") == 0) {
-        texture = list_get(textures, 6);
-      }
-      else if (strcmp(file, "assets/victory_screen.jpeg") == 0) {
-        texture = list_get(textures, 7);
-      }
-      else if (strcmp(file, "assets/game_over_screen.jpeg") == 0) {
-        texture = list_get(textures, 8);
+
+// the sprite for id, loading it on its own the first time it's needed;
+// NULL while the loader is still decoding it
+sprite_t *sdl_get_sprite(size_t id) {
+  grow_sprites(texture_count());
+  sprite_t *sprite = &sprites[id];
+  if (sprite->texture == NULL) {
+    if (sprite->pending) {
+      return NULL;
+    }
+    SDL_Surface *surface = IMG_Load(texture_get_path(id));
+    assert(surface != NULL);
+    *sprite = (sprite_t){
+        .texture = SDL_CreateTextureFromSurface(renderer, surface),
+        .uv_min = {0, 0},
+        .uv_max = {1, 1}};
+    SDL_FreeSurface(surface);
+  }
+  return sprite;
+}
+
+int slot_compare(const void *a, const void *b) {
+  const atlas_slot_t *first = a, *second = b;
+  if (first->rect.h != second->rect.h) {
+    return first->rect.h > second->rect.h ? -1 : 1;
+  }
+  return first->id < second->id ? -1 : 1;
+}
+
+// packs the atlas slots into one texture, each sprite scaled to the size
+// it's drawn at, with shelves filled tallest first
+void pack_sprite_atlas(void) {
+  size_t packed = atlas_slot_count;
+  atlas_slot_t *slots = atlas_slots;
+  qsort(slots, packed, sizeof(atlas_slot_t), slot_compare);
+  int x = 0, y = 0, shelf = 0;
+  for (size_t i = 0; i < packed; i++) {
+    SDL_Rect *rect = &slots[i].rect;
+    if (x + rect->w > SPRITE_ATLAS_WIDTH) {
+      x = 0;
+      y += shelf + SPRITE_PADDING;
+      shelf = 0;
+    }
+    rect->x = x;
+    rect->y = y;
+    x += rect->w + SPRITE_PADDING;
+    shelf = rect->h > shelf ? rect->h : shelf;
+  }
+  int height = y + shelf;
+  SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(
+      0, SPRITE_ATLAS_WIDTH, height, 32, SDL_PIXELFORMAT_RGBA32);
+  assert(atlas != NULL);
+  for (size_t i = 0; i < packed; i++) {
+    if (!slots[i].decoded) {
+      continue;
+    }
+    SDL_SetSurfaceBlendMode(slots[i].surface, SDL_BLENDMODE_NONE);
+    SDL_BlitScaled(slots[i].surface, NULL, atlas, &slots[i].rect);
+    SDL_FreeSurface(slots[i].surface);
+    slots[i].surface = NULL;
+  }
+  SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, atlas);
+  SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+  SDL_FreeSurface(atlas);
+  for (size_t i = 0; i < packed; i++) {
+    SDL_Rect rect = slots[i].rect;
+    sprite_t *sprite = &sprites[slots[i].id];
+    // critical sprites were drawn on their own until now
+    if (sprite->texture != NULL) {
+      SDL_DestroyTexture(sprite->texture);
+    }
+    // sprites that failed to decode stay pending and are drawn as shapes
+    *sprite = (sprite_t){
+        .texture = slots[i].decoded ? texture : NULL,
+        .pending = !slots[i].decoded,
+        .uv_min = {(float)rect.x / SPRITE_ATLAS_WIDTH, (float)rect.y / height},
+        .uv_max = {(float)(rect.x + rect.w) / SPRITE_ATLAS_WIDTH,
+                   (float)(rect.y + rect.h) / height}};
+  }
+}
+
+// called on loader threads; nothing here may touch the renderer
+void *decode_asset(asset_kind_t kind, const char *path) {
+  switch (kind) {
+  case ASSET_IMAGE:
+    return IMG_Load(path);
+  case ASSET_SOUND:
+    return Mix_LoadWAV(path);
+  case ASSET_MUSIC:
+    // only opens the file; it's decoded a buffer at a time while playing
+    return Mix_LoadMUS(path);
+  case ASSET_FONT:
+    return hud_build_atlas(path);
+  default:
+    return NULL;
+  }
+}
+
+void take_image(size_t id, SDL_Surface *surface, bool critical) {
+  sprite_t *sprite = &sprites[id];
+  if (sprite->packed) {
+    for (size_t i = 0; i < atlas_slot_count; i++) {
+      if (atlas_slots[i].id == id) {
+        atlas_slots[i].surface = surface;
+        atlas_slots[i].decoded = surface != NULL;
       }
-      // texture = list_get(textures, 1);
-      SDL_Rect texture_rect;
-      texture_rect.x = center.x;
-      texture_rect.y = center.y;
-      if ((strcmp(file, "assets/stalker_up.png") == 0) || (strcmp(file, "assets/player_down.png") == 0) || (strcmp(file, "assets/coin.png") == 0)) {
-        texture_rect.w = 50.0;
-        texture_rect.h = 50.0;
+    }
+    // sprites needed for the first frame don't wait for the whole atlas
+    if (critical && surface != NULL) {
+      sprite->texture = SDL_CreateTextureFromSurface(renderer, surface);
+      sprite->uv_min = (SDL_FPoint){0, 0};
+      sprite->uv_max = (SDL_FPoint){1, 1};
+    }
+    atlas_waiting--;
+    if (atlas_waiting == 0) {
+      pack_sprite_atlas();
+    }
+    return;
+  }
+  if (surface != NULL) {
+    *sprite = (sprite_t){
+        .texture = SDL_CreateTextureFromSurface(renderer, surface),
+        .pending = false,
+        .uv_min = {0, 0},
+        .uv_max = {1, 1}};
+    SDL_FreeSurface(surface);
+  }
+}
+
+// the first font to load becomes the HUD's; any others are dropped
+void take_font(hud_font_t *font) {
+  if (font == NULL) {
+    return;
+  }
+  if (hud_atlas == NULL) {
+    hud_atlas = SDL_CreateTextureFromSurface(renderer, font->atlas);
+    SDL_SetTextureBlendMode(hud_atlas, SDL_BLENDMODE_BLEND);
+    memcpy(hud_glyph_rects, font->glyph_rects, sizeof(hud_glyph_rects));
+    hud_atlas_width = font->atlas_width;
+    hud_atlas_height = font->atlas_height;
+    hud_font_height = font->font_height;
+  }
+  SDL_FreeSurface(font->atlas);
+  tracked_free(font);
+}
+
+// uploads or files away everything the loader finished since the last call
+void sdl_pump_assets(void) {
+  if (assets == NULL) {
+    return;
+  }
+  size_t index;
+  while (loader_next_ready(assets, &index)) {
+    void *data = loader_get_data(assets, index);
+    const char *name = loader_get_name(assets, index);
+    switch (loader_get_kind(assets, index)) {
+    case ASSET_IMAGE:
+      take_image(texture_intern(loader_get_path(assets, index)), data,
+                 loader_is_critical(assets, index));
+      break;
+    case ASSET_SOUND:
+      for (size_t s = 0; s < NUM_SFX; s++) {
+        if (strcmp(name, SFX_TABLE[s].name) == 0 && sound_effects[s] == NULL) {
+          sound_effects[s] = data;
+          data = NULL;
+        }
       }
-      else if ((strcmp(file, "assets/purple_background.png") == 0) || (strcmp(file, "assets/victory_screen.jpeg") == 0) || (strcmp(file, "assets/game_over_screen.jpeg") == 0)) {
-        texture_rect.w = WINDOW_WIDTH - 1;
-        texture_rect.h = WINDOW_HEIGHT - 1;
+      if (data != NULL) {
+        Mix_FreeChunk(data);
       }
-      else {
-        texture_rect.w = 100.0;
-        texture_rect.h = 100.0;
+      break;
+    case ASSET_MUSIC:
+      if (music_track == NULL) {
+        music_track = data;
+      } else if (data != NULL) {
+        Mix_FreeMusic(data);
       }
-  
-      SDL_RenderCopy(renderer, texture, NULL, &texture_rect); 
-      SDL_RenderPresent(renderer);
+      break;
+    case ASSET_FONT:
+      take_font(data);
+      break;
+    default:
+      break;
     }
-    else {
-      list_t *shape = body_get_shape(curr);
-      sdl_draw_polygon(shape, body_get_color(curr));
-      list_free(shape);
   }
-  
-  sdl_show();
+  if (loader_is_done(assets)) {
+    loader_free(assets);
+    assets = NULL;
+    tracked_free(atlas_slots);
+    atlas_slots = NULL;
+    atlas_slot_count = 0;
+  }
 }
+
+// starts loading the manifest's assets and waits for just the critical ones.
+// Call after the game has registered its textures: sprites drawn no bigger
+// than SPRITE_ATLAS_MAX_SIZE are packed into one atlas so they draw in a
+// single call, and the rest are loaded on their own. Textures missing from
+// the manifest are loaded the first time they're drawn.
+void sdl_load_assets(void) {
+  grow_sprites(texture_count());
+  assets = loader_init(ASSET_MANIFEST, LOADER_THREADS, decode_asset);
+  if (assets == NULL) {
+    fprintf(stderr, "couldn't read asset manifest %s\n", ASSET_MANIFEST);
+    return;
+  }
+  size_t size = loader_size(assets);
+  atlas_slots =
+      tracked_malloc(sizeof(atlas_slot_t) * (size + 1), ALLOC_RENDER);
+  assert(atlas_slots != NULL);
+  for (size_t i = 0; i < size; i++) {
+    if (loader_get_kind(assets, i) != ASSET_IMAGE) {
+      continue;
+    }
+    size_t id = texture_intern(loader_get_path(assets, i));
+    grow_sprites(texture_count());
+    vector_t draw_size = texture_get_size(id);
+    sprites[id].pending = true;
+    if (draw_size.x <= SPRITE_ATLAS_MAX_SIZE &&
+        draw_size.y <= SPRITE_ATLAS_MAX_SIZE) {
+      sprites[id].packed = true;
+      atlas_slots[atlas_slot_count++] = (atlas_slot_t){
+          .id = id,
+          .surface = NULL,
+          .decoded = false,
+          .rect = {.w = ceil(draw_size.x), .h = ceil(draw_size.y)}};
+    }
+  }
+  atlas_waiting = atlas_slot_count;
+  loader_wait_critical(assets);
+  sdl_pump_assets();
 }
 
-void sdl_render_text_time(time_t time_left){
-  TTF_Font* space_font = TTF_OpenFont("assets/AlienRavager-0WYod.ttf", 24);
-  SDL_Color White = {255, 255, 255};
-  size_t timer_text = (size_t)time_left;
-  char *time_statement;
-  sprintf(time_statement, "%zu seconds", timer_text);
-  SDL_Surface* surface_message =
-      TTF_RenderText_Solid(space_font, time_statement, White);
+// sprites covering the window and drawn over moving bodies, like the
+// outcome screens, have to stay on top of them rather than under
+bool is_overlay(const render_item_t *item, bool after_dynamic) {
+  if (!after_dynamic || item->texture_id == NO_TEXTURE) {
+    return false;
+  }
+  vector_t size = item->texture_size;
+  return size.x >= WINDOW_WIDTH - 1 && size.y >= WINDOW_HEIGHT - 1;
+}
 
-  SDL_Texture* message = SDL_CreateTextureFromSurface(renderer, surface_message);
+uint64_t hash_bytes(uint64_t hash, const void *bytes, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= ((const uint8_t *)bytes)[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
 
-  SDL_Rect message_rect;
-  message_rect.x = 5;
-  message_rect.y = 0;
-  message_rect.w = 250;
-  message_rect.h = 50;
+// everything that changes how a static item is drawn
+uint64_t hash_item(uint64_t hash, const render_item_t *item) {
+  // a sprite can finish loading after the layer was drawn
+  SDL_Texture *texture = NULL;
+  if (item->texture_id != NO_TEXTURE && item->texture_id < sprites_size) {
+    texture = sprites[item->texture_id].texture;
+  }
+  hash = hash_bytes(hash, &item->centroid.x, sizeof(double));
+  hash = hash_bytes(hash, &item->centroid.y, sizeof(double));
+  hash = hash_bytes(hash, &item->angle, sizeof(double));
+  hash = hash_bytes(hash, &item->color.r, sizeof(float));
+  hash = hash_bytes(hash, &item->color.g, sizeof(float));
+  hash = hash_bytes(hash, &item->color.b, sizeof(float));
+  hash = hash_bytes(hash, &item->vertex_count, sizeof(size_t));
+  hash = hash_bytes(hash, &item->texture_id, sizeof(size_t));
+  return hash_bytes(hash, &texture, sizeof(texture));
+}
 
-  SDL_RenderCopy(renderer, message, NULL, &message_rect);
-  SDL_FreeSurface(surface_message);
-  SDL_DestroyTexture(message);
+// queues item unless it's off screen; items whose sprite is still loading
+// are drawn as their shape
+void queue_item(render_snapshot_t *snapshot, const render_item_t *item,
+                vector_t window_size) {
+  sprite_t *sprite = item->texture_id != NO_TEXTURE
+                         ? sdl_get_sprite(item->texture_id)
+                         : NULL;
+  if (sprite != NULL) {
+    vector_t center = item->centroid;
+    vector_t size = item->texture_size;
+    // sprites are placed in pixels, with the centroid as the corner
+    if (center.x >= window_size.x || center.y >= window_size.y ||
+        center.x + size.x <= 0 || center.y + size.y <= 0) {
+      return;
+    }
+    SDL_Rect texture_rect = {
+        .x = center.x, .y = center.y, .w = size.x, .h = size.y};
+    sdl_queue_sprite(sprite, texture_rect);
+    return;
+  }
+  if (item->min.x > view_max.x || item->min.y > view_max.y ||
+      item->max.x < view_min.x || item->max.y < view_min.y) {
+    return;
+  }
+  queue_outline(snapshot, item);
+}
 
-  sdl_show();
+// redraws the static layer if the window was resized or a static item
+// changed since it was last drawn. The queue must be empty.
+void update_static_layer(render_snapshot_t *snapshot, size_t count) {
+  int width = 2 * frame_center.x, height = 2 * frame_center.y;
+  uint64_t signature = 0xcbf29ce484222325;
+  for (size_t i = 0; i < count; i++) {
+    signature = hash_bytes(signature, &static_bodies[i], sizeof(size_t));
+    signature =
+        hash_item(signature, render_snapshot_get(snapshot, static_bodies[i]));
+  }
+  if (static_layer != NULL && !static_lost && signature == static_signature &&
+      width == static_width && height == static_height) {
+    return;
+  }
+  if (static_layer == NULL || width != static_width ||
+      height != static_height) {
+    if (static_layer != NULL) {
+      SDL_DestroyTexture(static_layer);
+    }
+    static_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                     SDL_TEXTUREACCESS_TARGET, width, height);
+    assert(static_layer != NULL);
+    static_width = width;
+    static_height = height;
+  }
+  static_signature = signature;
+  static_lost = false;
+  SDL_SetRenderTarget(renderer, static_layer);
+  SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+  SDL_RenderClear(renderer);
+  vector_t window_size = {.x = width, .y = height};
+  for (size_t i = 0; i < count; i++) {
+    queue_item(snapshot, render_snapshot_get(snapshot, static_bodies[i]),
+               window_size);
+  }
+  sdl_flush();
+  draw_boundary();
+  SDL_SetRenderTarget(renderer, NULL);
+  segment = 0;
 }
 
- void sdl_render_text_coins(body_t *body){
-  TTF_Font* space_font = TTF_OpenFont("assets/AlienRavager-0WYod.ttf", 24);
-  SDL_Color white = {255, 255, 255};
+// queues a snapshot's bodies; nothing reaches the screen until sdl_show().
+// Static bodies come from the static layer, drawn under everything else,
+// and bodies outside the window are skipped.
+void sdl_render_snapshot(render_snapshot_t *snapshot) {
+  profiler_begin(PROFILE_RENDER);
+  sdl_clear();
+  size_t items = render_snapshot_size(snapshot);
+  static_bodies =
+      reserve(static_bodies, &static_capacity, items, sizeof(size_t));
+  size_t static_count = 0;
+  bool after_dynamic = false;
+  for (size_t i = 0; i < items; i++) {
+    const render_item_t *item = render_snapshot_get(snapshot, i);
+    if (!item->is_static) {
+      after_dynamic = true;
+    } else if (!is_overlay(item, after_dynamic)) {
+      static_bodies[static_count++] = i;
+    }
+  }
+  update_static_layer(snapshot, static_count);
+  sdl_queue_sprite(&(sprite_t){.texture = static_layer,
+                               .uv_min = {0, 0},
+                               .uv_max = {1, 1}},
+                   (SDL_Rect){.w = static_width, .h = static_height});
+  // nothing may be sorted under the layer, whatever the window size
+  segment++;
 
-  char *time_statement;
-  sprintf(time_statement, "%zu coins", body_get_coins(body));
-  SDL_Surface* surface_message =
-      TTF_RenderText_Solid(space_font, time_statement, white);
+  vector_t window_size = vec_multiply(2, frame_center);
+  after_dynamic = false;
+  for (size_t i = 0; i < items; i++) {
+    const render_item_t *item = render_snapshot_get(snapshot, i);
+    if (!item->is_static) {
+      after_dynamic = true;
+    } else if (!is_overlay(item, after_dynamic)) {
+      continue;
+    }
+    queue_item(snapshot, item, window_size);
+  }
+  profiler_end(PROFILE_RENDER);
+}
 
-  SDL_Texture* message = SDL_CreateTextureFromSurface(renderer, surface_message);
+// captures scene into a snapshot of its own and renders that, for games
+// that simulate and render on the same thread
+void sdl_render_scene(scene_t *scene) {
+  if (scene_capture == NULL) {
+    scene_capture = render_snapshot_init();
+  }
+  render_snapshot_capture(scene_capture, scene);
+  sdl_render_snapshot(scene_capture);
+}
 
-  SDL_Rect message_rect;
-  message_rect.x = 5;
-  message_rect.y = 60;
-  message_rect.w = 250; 
-  message_rect.h = 50; 
+// composes label's text from the glyph atlas, scaled to fill its rect
+void hud_build_label(hud_label_t *label, size_t value) {
+  char text[HUD_LABEL_LENGTH + 1];
+  snprintf(text, sizeof(text), label->format, value);
+  size_t length = strlen(text);
+  int width = 0;
+  for (size_t i = 0; i < length; i++) {
+    width += hud_glyph(text[i])->w;
+  }
+  double x_scale = width > 0 ? (double)label->rect.w / width : 0;
+  double y_scale = (double)label->rect.h / hud_font_height;
+  double x = label->rect.x;
+  for (size_t i = 0; i < length; i++) {
+    SDL_Rect *glyph = hud_glyph(text[i]);
+    SDL_Rect dest = {.x = round(x),
+                     .y = label->rect.y,
+                     .w = round(x + glyph->w * x_scale) - round(x),
+                     .h = round(glyph->h * y_scale)};
+    SDL_FPoint uv_min = {(float)glyph->x / hud_atlas_width,
+                         (float)glyph->y / hud_atlas_height};
+    SDL_FPoint uv_max = {(float)(glyph->x + glyph->w) / hud_atlas_width,
+                         (float)(glyph->y + glyph->h) / hud_atlas_height};
+    make_quad(&label->quads[4 * i], dest, uv_min, uv_max);
+    x += glyph->w * x_scale;
+  }
+  label->glyphs = length;
+  label->value = value;
+  label->built = true;
+}
 
-  SDL_RenderCopy(renderer, message, NULL, &message_rect);
-  SDL_FreeSurface(surface_message);
-  SDL_DestroyTexture(message);
+// queues label on top of everything queued so far, rebuilding it only when
+// value changed since it was last drawn
+void hud_draw_label(hud_label_t *label, size_t value) {
+  if (hud_atlas == NULL) {
+    return;
+  }
+  if (!label->built || label->value != value) {
+    hud_build_label(label, value);
+  }
+  // labels drawn back to back share a segment, and so a draw call
+  if (command_count == 0 || commands[command_count - 1].texture != hud_atlas) {
+    segment++;
+  }
+  queue_quads(hud_atlas, label->quads, label->glyphs);
+}
+
+void sdl_render_text_time(time_t time_left) {
+  hud_draw_label(&time_label, (size_t)time_left);
+}
+
+void sdl_render_text_coin_count(size_t coins) {
+  hud_draw_label(&coins_label, coins);
+}
 
-  sdl_show();
+void sdl_render_text_coins(body_t *body) {
+  sdl_render_text_coin_count(body_get_coins(body));
 }
 
 // referencing https://wiki.libsdl.org/SDL2_mixer/CategoryAPI
 // -1 = error, 0 = okay
 int sdl_render_music() {
-  Mix_Chunk *music = list_get(music_tracks, 0);
-
   // check that the music objects isn't null
-  if (music == NULL) {
+  if (music_track == NULL) {
     return -1;
   }
 
-  if (Mix_PlayChannel(-1, music, 0) == -1) {
-      return -1;
+  if (Mix_PlayMusic(music_track, 1) == -1) {
+    return -1;
   }
 
   return 0;
 }
 
-int sdl_render_sfx(int sound_to_make) {
-  // sfxs
-  Mix_Chunk *dash = list_get(sound_effects, 0);
-  Mix_Chunk *victory = list_get(sound_effects, 1);
-  Mix_Chunk *defeat = list_get(sound_effects, 2);
-
-  // check that the sfx aren't null
-  if (dash == NULL || victory == NULL || defeat == NULL) {
-        return -1;
+// a free voice, else the oldest voice playing something of no higher
+// priority; -1 if every voice is busy with something more important
+int choose_voice(int priority) {
+  int chosen = -1;
+  for (int voice = 0; voice < SFX_VOICES; voice++) {
+    if (!Mix_Playing(voice)) {
+      return voice;
+    }
+    if (voice_priority[voice] <= priority &&
+        (chosen < 0 || voice_started[voice] < voice_started[chosen])) {
+      chosen = voice;
+    }
   }
+  return chosen;
+}
 
-  switch (sound_to_make) {
-    case 5:
-      if (Mix_PlayChannel(-1, dash, 0) == -1) {
-        return -1;
-      }      
-      break;
-    case 6:
-      Mix_HaltChannel(-1);
-      if (Mix_PlayChannel(-1, victory, 0) == -1) {
-        return -1;
-      }      
-      break;
-    case 7:
-      Mix_HaltChannel(-1);
-      if (Mix_PlayChannel(-1, defeat, 0) == -1) {
-        return -1;
-      }      
-      break;
+// -1 = error or no voice free, 0 = okay
+int sdl_render_sfx(sfx_t sound_to_make) {
+  assert(sound_to_make < NUM_SFX);
+  const sfx_entry_t *entry = &SFX_TABLE[sound_to_make];
+  Mix_Chunk *chunk = sound_effects[sound_to_make];
+  // not loaded yet, or failed to load
+  if (chunk == NULL) {
+    return -1;
   }
-
+  if (entry->exclusive) {
+    Mix_HaltChannel(-1);
+    Mix_HaltMusic();
+  }
+  int voice = choose_voice(entry->priority);
+  if (voice < 0) {
+    return -1;
+  }
+  Mix_HaltChannel(voice);
+  if (Mix_PlayChannel(voice, chunk, 0) == -1) {
+    return -1;
+  }
+  voice_priority[voice] = entry->priority;
+  voice_started[voice] = sfx_played++;
   return 0;
 }
 
 void sdl_on_key(key_handler_t handler) { key_handler = handler; }
 
+uint64_t sdl_session_seed(void) { return (uint64_t)time(NULL); }
+
 double time_since_last_tick(void) {
   clock_t now = clock();
   double difference = last_clock
@@ -0,0 +1,127 @@
+#include "snapshot.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// every record starts on an 8 byte boundary so a mapped file can be read in
+// place
+const size_t SNAPSHOT_ALIGNMENT = 8;
+
+// a growable byte buffer, or a read-only view of a mapped snapshot file
+typedef struct snapshot {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  bool mapped;
+} snapshot_t;
+
+snapshot_t *snapshot_init(size_t capacity) {
+  snapshot_t *out = malloc(sizeof(snapshot_t));
+  assert(out != NULL);
+  out->capacity = capacity > 0 ? capacity : SNAPSHOT_ALIGNMENT;
+  out->data = malloc(out->capacity);
+  assert(out->data != NULL);
+  out->size = 0;
+  out->mapped = false;
+  return out;
+}
+
+void snapshot_free(snapshot_t *snapshot) {
+  if (snapshot->mapped) {
+    munmap(snapshot->data, snapshot->size);
+  } else {
+    free(snapshot->data);
+  }
+  free(snapshot);
+}
+
+// keeps the allocation so a snapshot taken every tick stops allocating once
+// it has grown to fit the scene
+void snapshot_clear(snapshot_t *snapshot) {
+  assert(!snapshot->mapped);
+  snapshot->size = 0;
+}
+
+// appends zeroed space for bytes and returns its offset; offsets stay valid
+// when the buffer grows, pointers don't
+size_t snapshot_reserve(snapshot_t *snapshot, size_t bytes) {
+  assert(!snapshot->mapped);
+  size_t offset = (snapshot->size + SNAPSHOT_ALIGNMENT - 1) &
+                  ~(SNAPSHOT_ALIGNMENT - 1);
+  size_t end = offset + bytes;
+  if (end > snapshot->capacity) {
+    while (end > snapshot->capacity) {
+      snapshot->capacity *= 2;
+    }
+    snapshot->data = realloc(snapshot->data, snapshot->capacity);
+    assert(snapshot->data != NULL);
+  }
+  memset(snapshot->data + snapshot->size, 0, end - snapshot->size);
+  snapshot->size = end;
+  return offset;
+}
+
+void *snapshot_at(snapshot_t *snapshot, size_t offset) {
+  assert(offset <= snapshot->size);
+  return snapshot->data + offset;
+}
+
+const void *snapshot_data(snapshot_t *snapshot) { return snapshot->data; }
+
+size_t snapshot_size(snapshot_t *snapshot) { return snapshot->size; }
+
+// -1 = error, 0 = okay
+int snapshot_write_file(snapshot_t *snapshot, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return -1;
+  }
+  size_t written = fwrite(snapshot->data, 1, snapshot->size, file);
+  if (fclose(file) != 0 || written != snapshot->size) {
+    return -1;
+  }
+  return 0;
+}
+
+// maps a snapshot file read-only; restoring from it reads the records
+// straight out of the page cache. NULL on error
+snapshot_t *snapshot_map_file(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  snapshot_t *out = malloc(sizeof(snapshot_t));
+  assert(out != NULL);
+  out->data = data;
+  out->size = info.st_size;
+  out->capacity = info.st_size;
+  out->mapped = true;
+  return out;
+}
+
+// 64-bit FNV-1a over the snapshot bytes; equal scenes snapshot to equal bytes
+uint64_t snapshot_hash(snapshot_t *snapshot) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < snapshot->size; i++) {
+    hash ^= snapshot->data[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
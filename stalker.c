@@ -2,19 +2,36 @@
 #include "collision.h"
 #include "color.h"
 #include "forces.h"
+#include "input.h"
 #include "list.h"
+#include "placement.h"
 #include "polygon.h"
+#include "profiler.h"
+#include "render_snapshot.h"
+#include "replay.h"
 #include "scene.h"
+#include "scheduler.h"
 #include "sdl_wrapper.h"
 #include "state.h"
+#include "template.h"
+#include "texture.h"
+#include "trace.h"
 #include "vector.h"
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_ttf.h>
+
+// STALKER_RENDER_THREAD moves the simulation onto a thread of its own, which
+// hands the window's thread a snapshot of the scene after every step. The
+// profiler keeps one frame's timings in globals, so it can't be used there.
+#if defined(STALKER_RENDER_THREAD) && defined(STALKER_PROFILE)
+#error "STALKER_PROFILE can't be combined with STALKER_RENDER_THREAD"
+#endif
 
 // all constants
 // CHARACTER INITIALIZATIONS
@@ -28,6 +45,21 @@ const vector_t WINDOW = (vector_t){.x = 1000, .y = 500};
 const vector_t PLAYER_CENTER = (vector_t){.x = 500, .y = 250};
 const double GRAVITY = 1500;
 const double PELLET_CHANCE  = 0.002;
+// spawn chances are per frame at this rate; the scheduler turns them into
+// arrivals per second of simulation time
+const double NOMINAL_FRAME_RATE = 60;
+// the simulation advances in fixed steps, catching up at most this much
+// wall time per frame
+const double FIXED_STEP = 1.0 / 120;
+const double MAX_FRAME_TIME = 0.25;
+// keys that can wait for the next fixed step before more are dropped
+const size_t INPUT_RING_SIZE = 256;
+// the profiler overlay, toggled with p, in scene coordinates
+const vector_t PROFILE_OVERLAY_ORIGIN = (vector_t){.x = 780, .y = 120};
+const double PROFILE_OVERLAY_WIDTH = 200;
+const char PROFILE_KEY = 'p';
+// writes out the trace recorded so far, if STALKER_TRACE is set
+const char TRACE_KEY = 't';
 // stalker constants
 const double STALKER_MASS = 200;
 const double STALKER_RADIUS = 30;
@@ -47,6 +79,11 @@ const double OBSTACLE_MASS = 500;
 const int OBSTACLE_MIN_RADIUS = 15;
 const int OBSTACLE_MAX_RADIUS = 30;
 const int MIN_DISTANCE_BETWEEN = 80;
+// spawns are placed in this region, up to 100 px right of and 200 px below
+// the window, rejecting at most this many candidates before skipping
+const vector_t SPAWN_MIN = (vector_t){.x = 0, .y = 0};
+const vector_t SPAWN_MAX = (vector_t){.x = 1100, .y = 700};
+const size_t PLACEMENT_ATTEMPTS = 30;
 const double NUM_POINTS_OBSTACLE = 100;
 const rgb_color_t BOUNCING_OBSTACLE_COLOR = (rgb_color_t){.r = 1, .g = 0, .b = 0};
 const double NUM_BOUNCING_OBSTACLES = 5;
@@ -55,6 +92,16 @@ const double NUM_REDUCEVEL_OBSTACLE = 5;
 const rgb_color_t STALKERVEL_COLOR = (rgb_color_t){.r = 0, .g = 0, .b = 1.0};
 const double NUM_STALKERVEL_OBSTACLE  = 2;
 const double OBSTACLE_ELASTICITY = 1;
+// bodies kept ready in each spawn template's free list at startup
+const size_t TEMPLATE_PREALLOC = 16;
+// despawn constants - spawned bodies expire after their lifetime, when they
+// drift this far past the window, or lowest priority first past the cap
+const double COIN_LIFETIME = 12;
+const double OBSTACLE_LIFETIME = 20;
+const int COIN_PRIORITY = 1;
+const int OBSTACLE_PRIORITY = 0;
+const double DESPAWN_MARGIN = 250;
+const size_t MAX_SPAWNED = 64;
 
 // coin constants
 const rgb_color_t COIN_COLOR = (rgb_color_t){.r = 1.0, .g = 1.0, .b = 0.0};
@@ -81,13 +128,45 @@ const rgb_color_t WALL_COLOR = (rgb_color_t){.r = 1.0, .g = 1.0, .b = 1.0};
 // text
 const size_t FONT_SIZE = 1;
 
+// TEXTURES
+// sizes textures are drawn at; any other texture is drawn 100 by 100
+const vector_t SPRITE_SIZE = (vector_t){.x = 50, .y = 50};
+const vector_t SCREEN_SIZE = (vector_t){.x = 1000 - 1, .y = 500 - 1};
+
+
+// define enum for spawn templates
+enum Template { COIN_TEMPLATE, BOUNCING_TEMPLATE, REDUCE_TEMPLATE, POWER_TEMPLATE, NUM_TEMPLATES };
+
+// define enum for how the round ended
+enum Outcome { PLAYING, VICTORY, DEFEAT };
 
 // define state
 typedef struct state {
   scene_t *scene;
   bool is_held;
   int last_dir_held;
-  time_t start_time;
+  body_template_t *templates[NUM_TEMPLATES];
+  scheduler_t *spawns;
+  placement_t *placement;
+  double accumulator;
+  enum Outcome outcome;
+  // bodies in the scene once the outcome screen went up, which is last
+  size_t outcome_bodies;
+  size_t coins;
+  // the session being recorded or played back, or NULL
+  replay_t *replay;
+  bool diverged;
+  bool show_profile;
+  // fixed steps simulated so far
+  size_t ticks;
+  // keys waiting for the next fixed step, or NULL to apply them at once
+  input_ring_t *input;
+#ifdef STALKER_RENDER_THREAD
+  pthread_t simulation;
+  atomic_bool stopping;
+  // snapshots from the simulation thread to the window's
+  render_buffer_t *frames;
+#endif
 } state_t;
 
 // define enum for teams
@@ -108,10 +187,8 @@ info_t *info_init(enum Team team) {
   return out;
 }
 
-// make rectangle function for all bodies
-body_t *make_rectangle(scene_t *scene, vector_t center, rgb_color_t color, double height,
-                       double width, enum Team team, double mass, char* link) {
-  info_t *info = info_init(team);
+// rectangle outline shared by make_rectangle and the spawn templates
+list_t *rectangle_shape(vector_t center, double height, double width) {
   list_t *shape = list_init(4, free);
   vector_t *v = malloc(sizeof(vector_t));
   v->x = center.x - (width / 2.0);
@@ -129,6 +206,14 @@ body_t *make_rectangle(scene_t *scene, vector_t center, rgb_color_t color, doubl
   b->x = center.x + (width / 2.0);
   b->y = center.y + (height / 2.0);
   list_add(shape, b);
+  return shape;
+}
+
+// make rectangle function for all bodies
+body_t *make_rectangle(scene_t *scene, vector_t center, rgb_color_t color, double height,
+                       double width, enum Team team, double mass, char* link) {
+  info_t *info = info_init(team);
+  list_t *shape = rectangle_shape(center, height, width);
   body_t *rectangle =
       body_init_with_info(shape, mass, color, info, (free_func_t)free, link);
   return rectangle;
@@ -159,6 +244,19 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *state) {
   scene_t *scene = state->scene;
   body_t *player = scene_get_body(scene, 1);
 
+  // p toggles the profiler overlay and leaves the player alone
+  if (key == PROFILE_KEY) {
+    if (type == KEY_PRESSED) {
+      state->show_profile = !state->show_profile;
+    }
+    return;
+  }
+  if (key == TRACE_KEY) {
+    if (type == KEY_PRESSED) {
+      trace_flush();
+    }
+    return;
+  }
   if (type == KEY_PRESSED) {
     switch (key) {
     case A_KEY:
@@ -225,15 +323,10 @@ void make_stalker(scene_t *scene) {
 }
 
 // randomize obstacles and coins
-vector_t randomize_center(scene_t *scene) {
-  double x = (rand() % (size_t)(WINDOW.x + 100));
-  double y = (rand() % (size_t)(WINDOW.y + 200));
-  vector_t center = {.x = x, .y = y};
-  vector_t player_center = body_get_centroid(scene_get_body(scene, 1));
-  if ((center.x == player_center.x) && (center.y == player_center.y)) {
-    randomize_center(scene);
-  }
-  return center;
+// picks a blue-noise position at least MIN_DISTANCE_BETWEEN from every
+// moving body, including the player; false means the spawn should be skipped
+bool randomize_center(state_t *state, vector_t *center) {
+  return placement_sample(state->placement, state->scene, center);
 }
 
 void initialize_walls(scene_t *scene) {
@@ -275,121 +368,438 @@ void wrap_around(scene_t *scene, body_t *player) {
   body_set_centroid(player, center);
 }
 
-void coin_spawn(scene_t *scene) {
-  if (rand() < (double)RAND_MAX * (PELLET_CHANCE * 6)) {
-    vector_t center = randomize_center(scene);
-    info_t *info = info_init(COIN);
-    body_t *coin = make_rectangle(scene, center, COIN_COLOR, 20.0, 20.0, info->team, COIN_MASS, "assets/coin.png");
-    scene_add_body(scene, coin);
-    body_t *player = scene_get_body(scene, 1);
-    create_coin_collecting(scene, player, coin);
+// spawned bodies of one kind share a template's geometry and info
+body_template_t *make_template(rgb_color_t color, double height, double width,
+                               enum Team team, double mass, char *link) {
+  list_t *shape = rectangle_shape(VEC_ZERO, height, width);
+  return template_init(shape, mass, color, info_init(team), free, link,
+                       TEMPLATE_PREALLOC);
+}
+
+void make_templates(state_t *state) {
+  state->templates[COIN_TEMPLATE] = make_template(COIN_COLOR, 20.0, 20.0, COIN, COIN_MASS, "assets/coin.png");
+  state->templates[BOUNCING_TEMPLATE] = make_template(BOUNCING_OBSTACLE_COLOR, 50.0, 20.0, OBSTACLE, 100000000, "assets/bounce_obstacle_1.png");
+  state->templates[REDUCE_TEMPLATE] = make_template(REDUCEVEL_COLOR, 40.0, 20.0, OBSTACLE, OBSTACLE_MASS, "assets/bounce_obstacle_2.png");
+  state->templates[POWER_TEMPLATE] = make_template(STALKERVEL_COLOR, 40.0, 20.0, OBSTACLE, OBSTACLE_MASS, "assets/bounce_obstacle_3.png");
+}
+
+void coin_spawn(state_t *state) {
+  scene_t *scene = state->scene;
+  vector_t center;
+  if (!randomize_center(state, &center)) {
+    return;
   }
+  body_t *coin = template_spawn(state->templates[COIN_TEMPLATE], center);
+  scene_add_body_with_lifetime(scene, coin, COIN_LIFETIME, COIN_PRIORITY);
+  body_t *player = scene_get_body(scene, 1);
+  create_coin_collecting(scene, player, coin);
 }
 
 // creates the obstacles that cause the obstacle to change directions
-void bouncing_spawn(scene_t *scene) {
-  if (rand() < (double)RAND_MAX * (PELLET_CHANCE * 0.8)) {
-    vector_t center = randomize_center(scene);
-    info_t *info = info_init(OBSTACLE);
-    body_t *new_bouncing = make_rectangle(scene, center, BOUNCING_OBSTACLE_COLOR, 50.0, 20.0, info->team, 100000000, "assets/bounce_obstacle_1.png");
-    body_t *player = scene_get_body(scene, 1);
-    vector_t vel = (vector_t){.x = 100, .y = 100};
-    body_set_velocity(new_bouncing, vel);
-    create_delete_bounce(scene, 1.5, new_bouncing,
-                          player);
-    body_t *rectangle1 = scene_get_body(scene, 3);
-    body_t *rectangle2 = scene_get_body(scene, 4);
-    body_t *rectangle3 = scene_get_body(scene, 5);
-    body_t *rectangle4 = scene_get_body(scene, 6);
-    scene_add_body(scene, new_bouncing);
-    create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle1, new_bouncing);
-    create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle2, new_bouncing);
-    create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle3, new_bouncing);
-    create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle4, new_bouncing);
-    create_destructive_collision(scene, player, new_bouncing);
-    }
+void bouncing_spawn(state_t *state) {
+  scene_t *scene = state->scene;
+  vector_t center;
+  if (!randomize_center(state, &center)) {
+    return;
+  }
+  body_t *new_bouncing = template_spawn(state->templates[BOUNCING_TEMPLATE], center);
+  body_t *player = scene_get_body(scene, 1);
+  vector_t vel = (vector_t){.x = 100, .y = 100};
+  body_set_velocity(new_bouncing, vel);
+  create_delete_bounce(scene, 1.5, new_bouncing,
+                        player);
+  body_t *rectangle1 = scene_get_body(scene, 3);
+  body_t *rectangle2 = scene_get_body(scene, 4);
+  body_t *rectangle3 = scene_get_body(scene, 5);
+  body_t *rectangle4 = scene_get_body(scene, 6);
+  scene_add_body_with_lifetime(scene, new_bouncing, OBSTACLE_LIFETIME, OBSTACLE_PRIORITY);
+  create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle1, new_bouncing);
+  create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle2, new_bouncing);
+  create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle3, new_bouncing);
+  create_physics_collision(scene, OBSTACLE_ELASTICITY, rectangle4, new_bouncing);
+  create_destructive_collision(scene, player, new_bouncing);
 }
 
 // change to gravitational vortex that ends game?
-void reduce_spawn(scene_t *scene) {
-    if (rand() < (double)RAND_MAX * PELLET_CHANCE) {
-      info_t *info = info_init(OBSTACLE);
-      vector_t center = (vector_t) randomize_center(scene);
-      body_t *obstacle = make_rectangle(scene, center, REDUCEVEL_COLOR, 40.0, 20.0, info->team, OBSTACLE_MASS, "assets/bounce_obstacle_2.png");
-      body_t *player = scene_get_body(scene, 1);
-      scene_add_body(scene, obstacle);
-      create_vortex(scene, GRAVITY, player, obstacle);
-      
-}
+void reduce_spawn(state_t *state) {
+  scene_t *scene = state->scene;
+  vector_t center;
+  if (!randomize_center(state, &center)) {
+    return;
+  }
+  body_t *obstacle = template_spawn(state->templates[REDUCE_TEMPLATE], center);
+  body_t *player = scene_get_body(scene, 1);
+  scene_add_body_with_lifetime(scene, obstacle, OBSTACLE_LIFETIME, OBSTACLE_PRIORITY);
+  create_vortex(scene, GRAVITY, player, obstacle);
 }
 
-void power_obstacle(scene_t *scene) {
-  if (rand() < (double)RAND_MAX * (PELLET_CHANCE * 3)) {
-    vector_t center = (vector_t) randomize_center(scene);
-    info_t *info = info_init(OBSTACLE);
-    body_t *obstacle = make_rectangle(scene, center, STALKERVEL_COLOR, 40.0, 20.0, info->team, OBSTACLE_MASS, "assets/bounce_obstacle_3.png");
-    scene_add_body(scene, obstacle);
-    body_t *stalker = scene_get_body(scene, 2);
-    create_collision_velocity(scene, stalker, obstacle);
+void power_obstacle(state_t *state) {
+  scene_t *scene = state->scene;
+  vector_t center;
+  if (!randomize_center(state, &center)) {
+    return;
+  }
+  body_t *obstacle = template_spawn(state->templates[POWER_TEMPLATE], center);
+  scene_add_body_with_lifetime(scene, obstacle, OBSTACLE_LIFETIME, OBSTACLE_PRIORITY);
+  body_t *stalker = scene_get_body(scene, 2);
+  create_collision_velocity(scene, stalker, obstacle);
 }
+
+// each spawner fires on its own poisson clock in simulation time
+void make_spawns(state_t *state) {
+  double now = scene_get_time(state->scene);
+  double rate = PELLET_CHANCE * NOMINAL_FRAME_RATE;
+  state->spawns = scheduler_init(4, scene_get_rng(state->scene));
+  scheduler_add(state->spawns, rate * 6, now, (spawner_t)coin_spawn, state);
+  scheduler_add(state->spawns, rate * 0.8, now, (spawner_t)bouncing_spawn, state);
+  scheduler_add(state->spawns, rate, now, (spawner_t)reduce_spawn, state);
+  scheduler_add(state->spawns, rate * 3, now, (spawner_t)power_obstacle, state);
 }
 
-void is_game_over(scene_t *scene) {
+// decides the outcome once and covers the scene with its screen
+void is_game_over(state_t *state) {
+  scene_t *scene = state->scene;
+  if (state->outcome != PLAYING) {
+    return;
+  }
   body_t *player = scene_get_body(scene, 1);
   info_t *info = (info_t *)body_get_info(player);
-  if (info->team != ALLY_PLAYER) {
-    outcome(scene, "assets/game_over_screen.jpeg");
+  if (info->team == ALLY_PLAYER) {
+    state->coins = body_get_coins(player);
   }
-  
-  if (body_get_coins(player) == 10) {
+  // checks every tick if time ran out
+  if (info->team != ALLY_PLAYER || scene_get_time(scene) >= TIMER) {
+    state->outcome = DEFEAT;
+    outcome(scene, "assets/game_over_screen.jpeg");
+  } else if (body_get_coins(player) == 10) {
+    state->outcome = VICTORY;
     outcome(scene, "assets/victory_screen.jpeg");
   }
+  if (state->outcome != PLAYING) {
+    state->outcome_bodies = scene_bodies(scene);
+  }
 }
 
+void register_textures(void) {
+  texture_register("assets/player_down.png", SPRITE_SIZE);
+  texture_register("assets/stalker_up.png", SPRITE_SIZE);
+  texture_register("assets/coin.png", SPRITE_SIZE);
+  texture_intern("assets/bounce_obstacle_1.png");
+  texture_intern("assets/bounce_obstacle_2.png");
+  texture_intern("assets/bounce_obstacle_3.png");
+  texture_register("assets/purple_background.png", SCREEN_SIZE);
+  texture_register("assets/victory_screen.jpeg", SCREEN_SIZE);
+  texture_register("assets/game_over_screen.jpeg", SCREEN_SIZE);
+}
 
-state_t *emscripten_init() {
+// builds a game without touching the sdl wrapper, so any number of games
+// can run side by side
+state_t *game_init(uint64_t seed) {
   state_t *state = malloc(sizeof(state_t));
   state->is_held = 0;
   state->last_dir_held = 3;
-  time_t start_time = time(NULL);
-  state->start_time = start_time; 
+  state->accumulator = 0;
+  state->outcome = PLAYING;
+  state->outcome_bodies = 0;
+  state->coins = 0;
+  state->replay = NULL;
+  state->diverged = false;
+  state->show_profile = false;
+  state->ticks = 0;
+  state->input = NULL;
+  register_textures();
   vector_t min = (vector_t){.x = 0, .y = 0};
-  sdl_init(min, WINDOW);
   // scene creation
   scene_t *scene = scene_init();
-  sdl_on_key(on_key);
+  scene_seed(scene, seed);
+  scene_set_despawn_policy(scene, min, WINDOW, DESPAWN_MARGIN, MAX_SPAWNED);
   state->scene = scene;
+  state->placement = placement_init(SPAWN_MIN, SPAWN_MAX, MIN_DISTANCE_BETWEEN,
+                                    PLACEMENT_ATTEMPTS, scene_get_rng(scene));
+  make_templates(state);
   make_background(scene, "assets/purple_background.png");
   make_player(scene);
   make_stalker(scene);
   initialize_walls(scene);
+  make_spawns(state);
   return state;
 }
 
-void emscripten_main(state_t *state) {
-  double dt = time_since_last_tick();
+// live keys are logged while recording and ignored while playing back
+void apply_session_key(char key, key_event_type_t type, double held_time,
+                       state_t *state) {
+  if (state->replay != NULL) {
+    if (replay_is_playing(state->replay)) {
+      return;
+    }
+    replay_key(state->replay, state->ticks, key, type, held_time);
+  }
+  on_key(key, type, held_time, state);
+}
+
+// applies the keys queued since the last fixed step, or the ones the replay
+// recorded for this step, so a key lands on the same step every run
+void apply_tick_input(state_t *state) {
+  replay_t *replay = state->replay;
+  if (replay != NULL && replay_is_playing(replay)) {
+    char key;
+    key_event_type_t type;
+    double held_time;
+    while (replay_next_key(replay, state->ticks, &key, &type, &held_time)) {
+      on_key(key, type, held_time, state);
+    }
+  }
+  if (state->input == NULL) {
+    return;
+  }
+  input_event_t event;
+  while (input_ring_pop(state->input, &event)) {
+    apply_session_key(event.key, event.type, event.held_time, state);
+  }
+}
+
+void game_step(state_t *state, double dt) {
   scene_t *scene = state->scene;
-  coin_spawn(scene);
-  bouncing_spawn(scene);
-  reduce_spawn(scene);
-  power_obstacle(scene);
-  wrap_around(scene, scene_get_body(scene, 1));
-  scene_tick(scene, dt);
-  time_t curr_time = time(NULL);
-  time_t time_elapsed = curr_time - state->start_time;
-  time_t time_left = TIMER - time_elapsed;
-  // checks every tick if time ran out
-  if (time_elapsed >= TIMER) {
-        outcome(scene, "assets/game_over_screen.jpeg");
+  // once the round is over nothing spawns or moves, so the outcome screen
+  // stays the last body drawn
+  if (state->outcome != PLAYING) {
+    assert(scene_bodies(scene) == state->outcome_bodies);
+    return;
+  }
+  state->accumulator += fmin(dt, MAX_FRAME_TIME);
+  while (state->accumulator >= FIXED_STEP) {
+    apply_tick_input(state);
+    profiler_begin(PROFILE_SPAWN);
+    scheduler_advance(state->spawns, scene_get_time(scene));
+    profiler_end(PROFILE_SPAWN);
+    wrap_around(scene, scene_get_body(scene, 1));
+    scene_tick(scene, FIXED_STEP);
+    state->accumulator -= FIXED_STEP;
+    state->ticks++;
+  }
+  is_game_over(state);
+}
+
+void game_key(state_t *state, char key, key_event_type_t type) {
+  on_key(key, type, 0, state);
+}
+
+bool game_is_over(state_t *state) { return state->outcome != PLAYING; }
+
+bool game_is_won(state_t *state) { return state->outcome == VICTORY; }
+
+double game_get_time(state_t *state) { return scene_get_time(state->scene); }
+
+size_t game_get_coins(state_t *state) { return state->coins; }
+
+scene_t *game_get_scene(state_t *state) { return state->scene; }
+
+void game_free(state_t *state) {
+  // spawned bodies recycle into their templates, so free the scene first
+  scene_free(state->scene);
+  for (size_t i = 0; i < NUM_TEMPLATES; i++) {
+    template_free(state->templates[i]);
+  }
+  scheduler_free(state->spawns);
+  placement_free(state->placement);
+  free(state);
+}
+
+// replays store bodies' info as their team
+uint32_t info_tag(void *info) { return ((info_t *)info)->team; }
+
+// keys from the window wait in the input ring for the next fixed step,
+// which may be on the simulation thread
+void session_key(char key, key_event_type_t type, double held_time,
+                 state_t *state) {
+  if (state->input == NULL) {
+    apply_session_key(key, type, held_time, state);
+    return;
+  }
+  input_event_t event = {.key = key,
+                         .type = type,
+                         .held_time = held_time,
+                         .timestamp = input_clock()};
+  input_ring_push(state->input, event);
+}
+
+// STALKER_RECORD=FILE records the session and STALKER_REPLAY=FILE plays one
+// back, with either backend
+replay_t *open_session_replay(void) {
+  const char *path = getenv("STALKER_REPLAY");
+  if (path != NULL) {
+    replay_t *replay = replay_open(path);
+    if (replay == NULL) {
+      fprintf(stderr, "couldn't open replay %s\n", path);
+    } else if (replay_get_step(replay) != FIXED_STEP) {
+      fprintf(stderr, "replay %s was recorded with a different step\n", path);
     }
-  is_game_over(scene);
+    return replay;
+  }
+  path = getenv("STALKER_RECORD");
+  if (path == NULL) {
+    return NULL;
+  }
+  replay_t *replay = replay_record(path, sdl_session_seed(), FIXED_STEP);
+  if (replay == NULL) {
+    fprintf(stderr, "couldn't record to %s\n", path);
+  }
+  return replay;
+}
+
+// plays back the frame time recorded for this frame, or records it
+double session_frame(state_t *state, double dt) {
+  replay_t *replay = state->replay;
+  if (replay == NULL) {
+    return dt;
+  }
+  return replay_frame(replay, dt);
+}
+
+// checks the frame just simulated against the replay, or records it
+void end_session_frame(state_t *state) {
+  if (state->replay != NULL &&
+      replay_end_frame(state->replay, state->scene, info_tag) != 0 &&
+      !state->diverged) {
+    state->diverged = true;
+    fprintf(stderr, "replay diverged by frame %zu\n",
+            replay_get_frame(state->replay) - 1);
+  }
+}
+
+// the timer runs on simulation time so headless runs aren't held to it
+time_t session_time_left(state_t *state) {
+  time_t time_elapsed = (time_t)scene_get_time(state->scene);
+  return time_elapsed < TIMER ? TIMER - time_elapsed : 0;
+}
+
+#ifdef STALKER_RENDER_THREAD
+// runs a frame's steps, then publishes what the window should show
+void simulate_frame(state_t *state, double dt) {
+  game_step(state, session_frame(state, dt));
+  end_session_frame(state);
+  render_snapshot_t *snapshot = render_buffer_back(state->frames);
+  render_snapshot_capture(snapshot, state->scene);
+  body_t *player = scene_get_body(state->scene, 1);
+  render_snapshot_set_hud(snapshot, session_time_left(state),
+                          body_get_coins(player));
+  render_buffer_publish(state->frames);
+}
+
+// simulates a frame every fixed step until emscripten_free(), never waiting
+// on the window; a late frame just covers more time
+void *simulation_thread(void *aux) {
+  state_t *state = aux;
+  double last = input_clock();
+  while (!atomic_load(&state->stopping)) {
+    double now = input_clock();
+    simulate_frame(state, now - last);
+    last = now;
+    double wake = now + FIXED_STEP;
+    struct timespec until = {.tv_sec = (time_t)wake,
+                             .tv_nsec = (long)((wake - floor(wake)) * 1e9)};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+  }
+  return NULL;
+}
+
+void start_simulation(state_t *state) {
+  state->frames = render_buffer_init();
+  atomic_init(&state->stopping, false);
+  int created =
+      pthread_create(&state->simulation, NULL, simulation_thread, state);
+  assert(created == 0);
+}
+
+// draws the newest snapshot; the scene itself belongs to the simulation
+// thread, so nothing here may touch it
+void emscripten_main(state_t *state) {
+  render_snapshot_t *snapshot = render_buffer_latest(state->frames);
+  if (snapshot == NULL) {
+    return;
+  }
+  sdl_render_snapshot(snapshot);
+  sdl_render_text_time(render_snapshot_time_left(snapshot));
+  sdl_render_text_coin_count(render_snapshot_coins(snapshot));
+  sdl_show();
+}
+#else
+void emscripten_main(state_t *state) {
+  profiler_begin(PROFILE_FRAME);
+  double dt = session_frame(state, time_since_last_tick());
+  game_step(state, dt);
+  end_session_frame(state);
+  scene_t *scene = state->scene;
+  time_t time_left = session_time_left(state);
   sdl_render_scene(scene);
+  profiler_begin(PROFILE_TEXT);
   sdl_render_text_time(time_left);
   body_t *player = scene_get_body(scene, 1);
   sdl_render_text_coins(player);
+  profiler_end(PROFILE_TEXT);
+  if (state->show_profile) {
+    profiler_draw_overlay(PROFILE_OVERLAY_ORIGIN, PROFILE_OVERLAY_WIDTH);
+  }
+  // the frame's only present, after everything has been queued
+  profiler_begin(PROFILE_RENDER);
+  sdl_show();
+  profiler_end(PROFILE_RENDER);
+  profiler_end(PROFILE_FRAME);
+  profiler_end_frame();
 }
+#endif
+
+state_t *emscripten_init() {
+  vector_t min = (vector_t){.x = 0, .y = 0};
+  sdl_init(min, WINDOW);
+  // STALKER_TRACE=FILE records a chrome://tracing timeline of the session
+  const char *trace_path = getenv("STALKER_TRACE");
+  if (trace_path != NULL && trace_start(trace_path) != 0) {
+    fprintf(stderr, "couldn't trace to %s\n", trace_path);
+  }
+#if !defined(STALKER_PROFILE) && !defined(STALKER_TRACING)
+  if (trace_path != NULL) {
+    fprintf(stderr,
+            "built without STALKER_TRACING, so the trace has no phases\n");
+  }
+#endif
+  replay_t *replay = open_session_replay();
+  uint64_t seed = replay != NULL ? replay_get_seed(replay) : sdl_session_seed();
+  state_t *state = game_init(seed);
+  state->replay = replay;
+  state->input = input_ring_init(INPUT_RING_SIZE);
+  sdl_load_assets();
+  sdl_on_key(session_key);
+#ifdef STALKER_RENDER_THREAD
+  start_simulation(state);
+#endif
+  return state;
+}
+
+bool game_replay_finished(state_t *state) {
+  return state->replay != NULL && replay_is_finished(state->replay);
+}
+
+bool game_replay_diverged(state_t *state) { return state->diverged; }
 
 void emscripten_free(state_t *state) {
-  scene_free(state->scene);
-  free(state);
+#ifdef STALKER_RENDER_THREAD
+  atomic_store(&state->stopping, true);
+  pthread_join(state->simulation, NULL);
+  render_buffer_free(state->frames);
+#endif
+  input_ring_t *input = state->input;
+  if (input_ring_taken(input) > 0 || input_ring_dropped(input) > 0) {
+    fprintf(stderr,
+            "input: %zu keys, latency mean %.2f ms max %.2f ms, %zu dropped\n",
+            input_ring_taken(input), input_ring_mean_latency(input) * 1e3,
+            input_ring_max_latency(input) * 1e3, input_ring_dropped(input));
+  }
+  input_ring_free(input);
+  trace_stop();
+  if (state->replay != NULL) {
+    replay_free(state->replay);
+  }
+  game_free(state);
+  texture_registry_free();
 }
@@ -0,0 +1,79 @@
+#include "template.h"
+#include "body.h"
+#include "geometry.h"
+#include "list.h"
+#include "polygon.h"
+#include <assert.h>
+#include <stdlib.h>
+
+// a template owns the geometry and info shared by every body spawned from
+// it; removed bodies come back through the recycler instead of being freed
+typedef struct body_template {
+  geometry_t *geometry;
+  double mass;
+  rgb_color_t color;
+  void *info;
+  free_func_t info_freer;
+  char *link;
+  list_t *free_bodies;
+} body_template_t;
+
+void template_recycle(body_t *body, void *aux) {
+  body_template_t *template = (body_template_t *)aux;
+  list_add(template->free_bodies, body);
+}
+
+body_t *template_make_body(body_template_t *template) {
+  body_t *body = body_init_with_geometry(template->geometry, template->mass,
+                                         template->color, template->info,
+                                         NULL, template->link);
+  body_set_recycler(body, template_recycle, template);
+  return body;
+}
+
+body_template_t *template_init(list_t *shape, double mass, rgb_color_t color,
+                               void *info, free_func_t info_freer, char *link,
+                               size_t prealloc) {
+  body_template_t *out = malloc(sizeof(body_template_t));
+  assert(out != NULL);
+  out->geometry = geometry_init(shape, polygon_centroid(shape));
+  list_free(shape);
+  out->mass = mass;
+  out->color = color;
+  out->info = info;
+  out->info_freer = info_freer;
+  out->link = link;
+  out->free_bodies = list_init(prealloc + 1, NULL);
+  for (size_t i = 0; i < prealloc; i++) {
+    list_add(out->free_bodies, template_make_body(out));
+  }
+  return out;
+}
+
+body_t *template_spawn(body_template_t *template, vector_t center) {
+  body_t *body;
+  if (list_size(template->free_bodies) > 0) {
+    body = list_remove_back(template->free_bodies);
+  } else {
+    body = template_make_body(template);
+  }
+  body_reset(body, center);
+  body_set_color(body, template->color);
+  return body;
+}
+
+// bodies still in a scene recycle into their template when freed, so the
+// scene has to be freed before its templates
+void template_free(body_template_t *template) {
+  while (list_size(template->free_bodies) > 0) {
+    body_t *body = list_remove_back(template->free_bodies);
+    body_set_recycler(body, NULL, NULL);
+    body_free(body);
+  }
+  list_free(template->free_bodies);
+  geometry_release(template->geometry);
+  if (template->info_freer != NULL && template->info != NULL) {
+    template->info_freer(template->info);
+  }
+  free(template);
+}
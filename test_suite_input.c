@@ -0,0 +1,145 @@
+#include "input.h"
+#include "test_util.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+input_event_t key_event(char key) {
+  return (input_event_t){.key = key,
+                         .type = KEY_PRESSED,
+                         .held_time = 0,
+                         .timestamp = input_clock()};
+}
+
+void test_empty_pop() {
+  input_ring_t *ring = input_ring_init(4);
+  input_event_t event;
+  assert(!input_ring_pop(ring, &event));
+  assert(input_ring_taken(ring) == 0);
+  assert(input_ring_mean_latency(ring) == 0);
+  input_ring_free(ring);
+}
+
+void test_push_pop_order() {
+  input_ring_t *ring = input_ring_init(8);
+  for (char key = 'a'; key < 'f'; key++) {
+    assert(input_ring_push(ring, key_event(key)));
+  }
+  input_event_t event;
+  for (char key = 'a'; key < 'f'; key++) {
+    assert(input_ring_pop(ring, &event));
+    assert(event.key == key);
+    assert(event.type == KEY_PRESSED);
+  }
+  assert(!input_ring_pop(ring, &event));
+  assert(input_ring_taken(ring) == 5);
+  input_ring_free(ring);
+}
+
+void test_full_drops() {
+  input_ring_t *ring = input_ring_init(4);
+  for (char key = 'a'; key < 'e'; key++) {
+    assert(input_ring_push(ring, key_event(key)));
+  }
+  assert(!input_ring_push(ring, key_event('x')));
+  assert(!input_ring_push(ring, key_event('y')));
+  assert(input_ring_dropped(ring) == 2);
+  // dropped events never show up, and popping makes room again
+  input_event_t event;
+  assert(input_ring_pop(ring, &event));
+  assert(event.key == 'a');
+  assert(input_ring_push(ring, key_event('e')));
+  for (char key = 'b'; key <= 'e'; key++) {
+    assert(input_ring_pop(ring, &event));
+    assert(event.key == key);
+  }
+  assert(!input_ring_pop(ring, &event));
+  assert(input_ring_dropped(ring) == 2);
+  input_ring_free(ring);
+}
+
+void test_wrap_around() {
+  input_ring_t *ring = input_ring_init(4);
+  input_event_t event;
+  // indices pass the capacity many times over
+  for (size_t i = 0; i < 1000; i++) {
+    char first = 'a' + i % 26, second = 'a' + (i + 1) % 26;
+    assert(input_ring_push(ring, key_event(first)));
+    assert(input_ring_push(ring, key_event(second)));
+    assert(input_ring_pop(ring, &event));
+    assert(event.key == first);
+    assert(input_ring_pop(ring, &event));
+    assert(event.key == second);
+  }
+  assert(!input_ring_pop(ring, &event));
+  assert(input_ring_taken(ring) == 2000);
+  assert(input_ring_dropped(ring) == 0);
+  input_ring_free(ring);
+}
+
+void test_latency() {
+  input_ring_t *ring = input_ring_init(4);
+  input_event_t event = key_event('a');
+  event.timestamp -= 0.5;
+  assert(input_ring_push(ring, event));
+  assert(input_ring_push(ring, key_event('b')));
+  assert(input_ring_pop(ring, &event));
+  assert(input_ring_pop(ring, &event));
+  assert(input_ring_max_latency(ring) >= 0.5);
+  assert(input_ring_max_latency(ring) < 1);
+  assert(input_ring_mean_latency(ring) >= 0.25);
+  assert(input_ring_mean_latency(ring) <= input_ring_max_latency(ring));
+  input_ring_free(ring);
+}
+
+#define THREADED_EVENTS 100000
+
+void *produce(void *aux) {
+  input_ring_t *ring = aux;
+  for (size_t i = 0; i < THREADED_EVENTS; i++) {
+    input_event_t event = key_event('a');
+    event.held_time = i;
+    while (!input_ring_push(ring, event)) {
+    }
+  }
+  return NULL;
+}
+
+// every event crosses threads exactly once and in order
+void test_threaded_order() {
+  input_ring_t *ring = input_ring_init(16);
+  pthread_t producer;
+  assert(pthread_create(&producer, NULL, produce, ring) == 0);
+  size_t expected = 0;
+  input_event_t event;
+  while (expected < THREADED_EVENTS) {
+    if (input_ring_pop(ring, &event)) {
+      assert(event.held_time == expected);
+      expected++;
+    }
+  }
+  pthread_join(producer, NULL);
+  assert(!input_ring_pop(ring, &event));
+  assert(input_ring_taken(ring) == THREADED_EVENTS);
+  input_ring_free(ring);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_empty_pop)
+  DO_TEST(test_push_pop_order)
+  DO_TEST(test_full_drops)
+  DO_TEST(test_wrap_around)
+  DO_TEST(test_latency)
+  DO_TEST(test_threaded_order)
+
+  puts("input_test PASS");
+}
@@ -0,0 +1,150 @@
+#include "loader.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// writes contents to a fresh temporary file and returns its path
+char *write_manifest(const char *contents) {
+  char *path = strdup("/tmp/manifest_XXXXXX");
+  assert(path != NULL);
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  size_t size = strlen(contents);
+  assert(write(fd, contents, size) == (ssize_t)size);
+  close(fd);
+  return path;
+}
+
+// the "decoded" asset is a copy of its path; paths starting with "bad"
+// fail to decode
+void *decode_path(asset_kind_t kind, const char *path) {
+  if (strncmp(path, "bad", 3) == 0) {
+    return NULL;
+  }
+  return strdup(path);
+}
+
+loader_t *load(const char *contents, size_t threads) {
+  char *path = write_manifest(contents);
+  loader_t *loader = loader_init(path, threads, decode_path);
+  unlink(path);
+  free(path);
+  return loader;
+}
+
+void test_missing_manifest() {
+  assert(loader_init("/tmp/no_such_manifest", 2, decode_path) == NULL);
+}
+
+void test_bad_lines() {
+  // unknown kind
+  assert(load("image ship ship.png\nvideo intro intro.mp4\n", 2) == NULL);
+  // too few fields
+  assert(load("image ship\n", 2) == NULL);
+  assert(load("sound\n", 2) == NULL);
+  // a fourth field that isn't the critical flag
+  assert(load("font hud hud.ttf urgent\n", 2) == NULL);
+}
+
+void test_comments_and_blanks() {
+  loader_t *loader = load("# assets\n"
+                          "\n"
+                          "image ship ship.png # the player\n"
+                          "   \n"
+                          "#sound boom boom.wav\n"
+                          "music theme theme.ogg\n",
+                          1);
+  assert(loader != NULL);
+  assert(loader_size(loader) == 2);
+  assert(loader_get_kind(loader, 0) == ASSET_IMAGE);
+  assert(strcmp(loader_get_name(loader, 0), "ship") == 0);
+  assert(strcmp(loader_get_path(loader, 0), "ship.png") == 0);
+  assert(loader_get_kind(loader, 1) == ASSET_MUSIC);
+  loader_wait_critical(loader);
+  size_t index;
+  while (!loader_is_done(loader)) {
+    if (loader_next_ready(loader, &index)) {
+      free(loader_get_data(loader, index));
+    }
+  }
+  loader_free(loader);
+}
+
+void test_empty_manifest() {
+  loader_t *loader = load("# nothing yet\n", 2);
+  assert(loader != NULL);
+  assert(loader_size(loader) == 0);
+  loader_wait_critical(loader);
+  assert(loader_is_done(loader));
+  size_t index;
+  assert(!loader_next_ready(loader, &index));
+  loader_free(loader);
+}
+
+const char *MANIFEST = "image a a.png\n"
+                       "sound b b.wav critical\n"
+                       "image c c.png\n"
+                       "font d d.ttf critical\n"
+                       "music e bad.ogg\n"
+                       "image f f.png critical\n"
+                       "sound g g.wav\n";
+
+void test_critical_first() {
+  loader_t *loader = load(MANIFEST, 3);
+  assert(loader != NULL);
+  assert(loader_size(loader) == 7);
+  for (size_t i = 0; i < 3; i++) {
+    assert(loader_is_critical(loader, i));
+  }
+  for (size_t i = 3; i < 7; i++) {
+    assert(!loader_is_critical(loader, i));
+  }
+  // once the wait returns, every critical asset is ready to collect
+  loader_wait_critical(loader);
+  bool seen[7] = {false};
+  size_t index;
+  for (size_t i = 0; i < 3; i++) {
+    assert(loader_next_ready(loader, &index));
+    assert(loader_is_critical(loader, index));
+    seen[index] = true;
+  }
+  while (!loader_is_done(loader)) {
+    if (loader_next_ready(loader, &index)) {
+      assert(!seen[index]);
+      seen[index] = true;
+    }
+  }
+  assert(!loader_next_ready(loader, &index));
+  for (size_t i = 0; i < 7; i++) {
+    assert(seen[i]);
+    char *data = loader_get_data(loader, i);
+    if (strcmp(loader_get_path(loader, i), "bad.ogg") == 0) {
+      assert(data == NULL);
+    } else {
+      assert(strcmp(data, loader_get_path(loader, i)) == 0);
+    }
+    free(data);
+  }
+  loader_free(loader);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_missing_manifest)
+  DO_TEST(test_bad_lines)
+  DO_TEST(test_comments_and_blanks)
+  DO_TEST(test_empty_manifest)
+  DO_TEST(test_critical_first)
+
+  puts("loader_test PASS");
+}
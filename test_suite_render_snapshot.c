@@ -0,0 +1,168 @@
+#include "body.h"
+#include "color.h"
+#include "list.h"
+#include "render_snapshot.h"
+#include "scene.h"
+#include "test_util.h"
+#include "texture.h"
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+const rgb_color_t SHAPE_COLOR = {.r = 0.25, .g = 0.5, .b = 1};
+
+list_t *square(vector_t center, double side) {
+  list_t *shape = list_init(4, free);
+  vector_t corners[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  for (size_t i = 0; i < 4; i++) {
+    vector_t *v = malloc(sizeof(vector_t));
+    assert(v != NULL);
+    *v = vec_add(center, vec_multiply(side / 2, corners[i]));
+    list_add(shape, v);
+  }
+  return shape;
+}
+
+void test_capture() {
+  texture_register("assets/coin.png", (vector_t){30, 40});
+  scene_t *scene = scene_init();
+  scene_add_body(scene, body_init(square((vector_t){10, 20}, 4), 1,
+                                  SHAPE_COLOR, "assets/coin.png"));
+  scene_add_body(scene, body_init(square((vector_t){0, 0}, 2), INFINITY,
+                                  SHAPE_COLOR, NULL));
+  render_snapshot_t *snapshot = render_snapshot_init();
+  render_snapshot_capture(snapshot, scene);
+  assert(render_snapshot_size(snapshot) == 2);
+
+  const render_item_t *moving = render_snapshot_get(snapshot, 0);
+  assert(vec_isclose(moving->centroid, (vector_t){10, 20}));
+  assert(vec_isclose(moving->min, (vector_t){8, 18}));
+  assert(vec_isclose(moving->max, (vector_t){12, 22}));
+  assert(moving->texture_id == texture_intern("assets/coin.png"));
+  assert(vec_isclose(moving->texture_size, (vector_t){30, 40}));
+  assert(!moving->is_static);
+  assert(moving->vertex_count == 4);
+  const vector_t *vertices = render_snapshot_vertices(snapshot, moving);
+  assert(vec_isclose(vertices[0], (vector_t){8, 18}));
+  assert(vec_isclose(vertices[2], (vector_t){12, 22}));
+
+  const render_item_t *wall = render_snapshot_get(snapshot, 1);
+  assert(wall->is_static);
+  assert(wall->texture_id == NO_TEXTURE);
+  assert(wall->first_vertex == 4);
+
+  // the snapshot is a copy; moving the body afterwards doesn't change it
+  body_set_centroid(scene_get_body(scene, 0), (vector_t){100, 100});
+  assert(vec_isclose(render_snapshot_vertices(snapshot, moving)[0],
+                     (vector_t){8, 18}));
+  render_snapshot_free(snapshot);
+  scene_free(scene);
+  texture_registry_free();
+}
+
+void publish(render_buffer_t *buffer, size_t tag) {
+  render_snapshot_set_hud(render_buffer_back(buffer), tag, 0);
+  render_buffer_publish(buffer);
+}
+
+void test_latest_before_publish() {
+  render_buffer_t *buffer = render_buffer_init();
+  assert(render_buffer_latest(buffer) == NULL);
+  assert(render_buffer_latest(buffer) == NULL);
+  render_buffer_free(buffer);
+}
+
+void test_freshness() {
+  render_buffer_t *buffer = render_buffer_init();
+  publish(buffer, 1);
+  render_snapshot_t *first = render_buffer_latest(buffer);
+  assert(first != NULL);
+  assert(render_snapshot_time_left(first) == 1);
+  // nothing new, so the reader keeps what it has
+  assert(render_buffer_latest(buffer) == first);
+  assert(render_snapshot_time_left(first) == 1);
+  publish(buffer, 2);
+  render_snapshot_t *second = render_buffer_latest(buffer);
+  assert(second != first);
+  assert(render_snapshot_time_left(second) == 2);
+  render_buffer_free(buffer);
+}
+
+void test_skips_stale() {
+  render_buffer_t *buffer = render_buffer_init();
+  publish(buffer, 1);
+  render_snapshot_t *held = render_buffer_latest(buffer);
+  // the writer runs ahead; the reader only ever sees the newest snapshot
+  for (size_t tag = 2; tag <= 10; tag++) {
+    publish(buffer, tag);
+    // and never writes into the one the reader holds
+    assert(render_buffer_back(buffer) != held);
+    assert(render_snapshot_time_left(held) == 1);
+  }
+  assert(render_snapshot_time_left(render_buffer_latest(buffer)) == 10);
+  render_buffer_free(buffer);
+}
+
+#define THREADED_FRAMES 20000
+
+typedef struct writer {
+  render_buffer_t *buffer;
+  atomic_bool done;
+} writer_t;
+
+void *write_frames(void *aux) {
+  writer_t *writer = aux;
+  for (size_t tag = 1; tag <= THREADED_FRAMES; tag++) {
+    render_snapshot_t *back = render_buffer_back(writer->buffer);
+    render_snapshot_set_hud(back, tag, tag);
+    render_buffer_publish(writer->buffer);
+  }
+  atomic_store(&writer->done, true);
+  return NULL;
+}
+
+// snapshots arrive whole and in order, though the reader may skip some
+void test_threaded_handoff() {
+  writer_t writer = {.buffer = render_buffer_init()};
+  atomic_init(&writer.done, false);
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, write_frames, &writer) == 0);
+  size_t last = 0;
+  while (true) {
+    bool done = atomic_load(&writer.done);
+    render_snapshot_t *snapshot = render_buffer_latest(writer.buffer);
+    if (snapshot != NULL) {
+      size_t tag = render_snapshot_time_left(snapshot);
+      assert(render_snapshot_coins(snapshot) == tag);
+      assert(tag >= last);
+      last = tag;
+    }
+    if (done) {
+      break;
+    }
+  }
+  pthread_join(thread, NULL);
+  assert(render_snapshot_time_left(render_buffer_latest(writer.buffer)) ==
+         THREADED_FRAMES);
+  render_buffer_free(writer.buffer);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_capture)
+  DO_TEST(test_latest_before_publish)
+  DO_TEST(test_freshness)
+  DO_TEST(test_skips_stale)
+  DO_TEST(test_threaded_handoff)
+
+  puts("render_snapshot_test PASS");
+}
@@ -0,0 +1,155 @@
+#include "rng.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define DRAWS 100000
+
+void test_same_seed() {
+  rng_t *a = rng_init(42);
+  rng_t *b = rng_init(42);
+  rng_t *c = rng_init(43);
+  bool differs = false;
+  for (size_t i = 0; i < 100; i++) {
+    uint64_t next = rng_next(a);
+    assert(next == rng_next(b));
+    differs |= next != rng_next(c);
+  }
+  assert(differs);
+  // reseeding restarts the stream
+  rng_seed(a, 42);
+  rng_t *d = rng_init(42);
+  assert(rng_next(a) == rng_next(d));
+  rng_free(a);
+  rng_free(b);
+  rng_free(c);
+  rng_free(d);
+}
+
+void test_double_bounds() {
+  rng_t *rng = rng_init(1);
+  double sum = 0;
+  for (size_t i = 0; i < DRAWS; i++) {
+    double x = rng_double(rng);
+    assert(x >= 0 && x < 1);
+    sum += x;
+  }
+  assert(fabs(sum / DRAWS - 0.5) < 0.01);
+  rng_free(rng);
+}
+
+void test_range() {
+  rng_t *rng = rng_init(2);
+  for (size_t i = 0; i < 100; i++) {
+    assert(rng_range(rng, 1) == 0);
+  }
+  // a bound just past 2^63 redraws most often; results must still fit
+  uint64_t big = ((uint64_t)1 << 63) + 1;
+  for (size_t i = 0; i < 100; i++) {
+    assert(rng_range(rng, big) < big);
+  }
+  size_t counts[6] = {0};
+  for (size_t i = 0; i < DRAWS * 6; i++) {
+    uint64_t r = rng_range(rng, 6);
+    assert(r < 6);
+    counts[r]++;
+  }
+  for (size_t i = 0; i < 6; i++) {
+    assert(counts[i] > DRAWS * 0.98 && counts[i] < DRAWS * 1.02);
+  }
+  rng_free(rng);
+}
+
+void test_fill() {
+  rng_t *a = rng_init(3);
+  rng_t *b = rng_init(3);
+  double doubles[16];
+  uint64_t ranges[16];
+  rng_fill_doubles(a, doubles, 16);
+  rng_fill_range(a, 10, ranges, 16);
+  for (size_t i = 0; i < 16; i++) {
+    assert(doubles[i] == rng_double(b));
+  }
+  for (size_t i = 0; i < 16; i++) {
+    assert(ranges[i] == rng_range(b, 10));
+  }
+  rng_free(a);
+  rng_free(b);
+}
+
+void test_state_round_trip() {
+  rng_t *a = rng_init(4);
+  rng_next(a);
+  uint64_t state[4];
+  rng_get_state(a, state);
+  uint64_t expected[8];
+  for (size_t i = 0; i < 8; i++) {
+    expected[i] = rng_next(a);
+  }
+  rng_t *b = rng_init(99);
+  rng_set_state(b, state);
+  for (size_t i = 0; i < 8; i++) {
+    assert(rng_next(b) == expected[i]);
+  }
+  rng_free(a);
+  rng_free(b);
+}
+
+void test_jump() {
+  rng_t *a = rng_init(5);
+  rng_t *b = rng_init(5);
+  uint64_t before[4], after[4];
+  rng_get_state(a, before);
+  rng_jump(a);
+  rng_get_state(a, after);
+  bool moved = false;
+  for (size_t i = 0; i < 4; i++) {
+    moved |= before[i] != after[i];
+  }
+  assert(moved);
+  // a jump depends only on the state it starts from
+  rng_jump(b);
+  for (size_t i = 0; i < 100; i++) {
+    assert(rng_next(a) == rng_next(b));
+  }
+  rng_free(a);
+  rng_free(b);
+}
+
+void test_split() {
+  rng_t *parent = rng_init(6);
+  rng_t *original = rng_init(6);
+  rng_t *jumped = rng_init(6);
+  rng_jump(jumped);
+  rng_t *child = rng_split(parent);
+  // the child carries on the parent's old stream, the parent jumps ahead
+  for (size_t i = 0; i < 100; i++) {
+    assert(rng_next(child) == rng_next(original));
+    assert(rng_next(parent) == rng_next(jumped));
+  }
+  rng_free(parent);
+  rng_free(original);
+  rng_free(jumped);
+  rng_free(child);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_same_seed)
+  DO_TEST(test_double_bounds)
+  DO_TEST(test_range)
+  DO_TEST(test_fill)
+  DO_TEST(test_state_round_trip)
+  DO_TEST(test_jump)
+  DO_TEST(test_split)
+
+  puts("rng_test PASS");
+}
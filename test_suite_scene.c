@@ -0,0 +1,438 @@
+#include "body.h"
+#include "color.h"
+#include "list.h"
+#include "placement.h"
+#include "rng.h"
+#include "scene.h"
+#include "template.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define BODIES 200
+#define ROUNDS 40
+#define QUERIES 20
+
+const rgb_color_t GRAY = {.r = 0.5, .g = 0.5, .b = 0.5};
+
+list_t *rectangle(vector_t center, double width, double height) {
+  list_t *shape = list_init(4, free);
+  vector_t corners[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  for (size_t i = 0; i < 4; i++) {
+    vector_t *v = malloc(sizeof(vector_t));
+    assert(v != NULL);
+    *v = (vector_t){center.x + corners[i].x * width / 2,
+                    center.y + corners[i].y * height / 2};
+    list_add(shape, v);
+  }
+  return shape;
+}
+
+// a body tagged with id, so results can be checked off against a scan
+body_t *tagged_box(vector_t center, double side, double mass, size_t id) {
+  size_t *tag = malloc(sizeof(size_t));
+  assert(tag != NULL);
+  *tag = id;
+  return body_init_with_info(rectangle(center, side, side), mass, GRAY, tag,
+                             free, NULL);
+}
+
+size_t body_id(body_t *body) { return *(size_t *)body_get_info(body); }
+
+double random_between(rng_t *rng, double min, double max) {
+  return min + rng_double(rng) * (max - min);
+}
+
+typedef struct hits {
+  size_t counts[BODIES];
+  double distances[BODIES];
+  size_t total;
+  // stop after this many hits, or 0 to take them all
+  size_t limit;
+} hits_t;
+
+void hits_clear(hits_t *hits, size_t limit) {
+  for (size_t i = 0; i < BODIES; i++) {
+    hits->counts[i] = 0;
+    hits->distances[i] = INFINITY;
+  }
+  hits->total = 0;
+  hits->limit = limit;
+}
+
+bool record_hit(body_t *body, void *aux) {
+  hits_t *hits = aux;
+  hits->counts[body_id(body)]++;
+  hits->total++;
+  return hits->limit == 0 || hits->total < hits->limit;
+}
+
+bool record_ray_hit(body_t *body, double distance, void *aux) {
+  hits_t *hits = aux;
+  hits->distances[body_id(body)] = distance;
+  return record_hit(body, aux);
+}
+
+double box_distance_squared(vector_t min, vector_t max, vector_t point) {
+  double dx = fmax(fmax(min.x - point.x, 0), point.x - max.x);
+  double dy = fmax(fmax(min.y - point.y, 0), point.y - max.y);
+  return dx * dx + dy * dy;
+}
+
+// every query has to report exactly the bodies a scan over the scene finds
+void check_queries(scene_t *scene, rng_t *rng) {
+  hits_t hits;
+  for (size_t q = 0; q < QUERIES; q++) {
+    vector_t min = {random_between(rng, -100, 1000),
+                    random_between(rng, -100, 1000)};
+    vector_t max = vec_add(min, (vector_t){random_between(rng, 0, 300),
+                                           random_between(rng, 0, 300)});
+    hits_clear(&hits, 0);
+    scene_query_aabb(scene, min, max, record_hit, &hits);
+    size_t expected = 0;
+    for (size_t i = 0; i < scene_bodies(scene); i++) {
+      body_t *body = scene_get_body(scene, i);
+      vector_t body_min, body_max;
+      body_get_bounds(body, &body_min, &body_max);
+      bool overlaps = body_min.x <= max.x && min.x <= body_max.x &&
+                      body_min.y <= max.y && min.y <= body_max.y;
+      assert(hits.counts[body_id(body)] == (overlaps ? 1 : 0));
+      expected += overlaps;
+    }
+    assert(hits.total == expected);
+
+    vector_t center = {random_between(rng, 0, 900),
+                       random_between(rng, 0, 900)};
+    double radius = random_between(rng, 0, 150);
+    hits_clear(&hits, 0);
+    scene_query_radius(scene, center, radius, record_hit, &hits);
+    expected = 0;
+    for (size_t i = 0; i < scene_bodies(scene); i++) {
+      body_t *body = scene_get_body(scene, i);
+      vector_t body_min, body_max;
+      body_get_bounds(body, &body_min, &body_max);
+      bool near = box_distance_squared(body_min, body_max, center) <=
+                  radius * radius;
+      assert(hits.counts[body_id(body)] == (near ? 1 : 0));
+      expected += near;
+    }
+    assert(hits.total == expected);
+
+    // a ray along +x meets a box iff it spans the ray's y and lies ahead
+    vector_t origin = {random_between(rng, -100, 900),
+                       random_between(rng, 0, 900)};
+    double reach = random_between(rng, 0, 600);
+    hits_clear(&hits, 0);
+    scene_raycast(scene, origin, (vector_t){3, 0}, reach, record_ray_hit,
+                  &hits);
+    expected = 0;
+    for (size_t i = 0; i < scene_bodies(scene); i++) {
+      body_t *body = scene_get_body(scene, i);
+      vector_t body_min, body_max;
+      body_get_bounds(body, &body_min, &body_max);
+      double distance = fmax(body_min.x - origin.x, 0);
+      bool hit = body_min.y <= origin.y && origin.y <= body_max.y &&
+                 body_max.x >= origin.x && distance <= reach;
+      size_t id = body_id(body);
+      assert(hits.counts[id] == (hit ? 1 : 0));
+      if (hit) {
+        assert(fabs(hits.distances[id] - distance) < 1e-9);
+      }
+      expected += hit;
+    }
+    assert(hits.total == expected);
+  }
+}
+
+// random moves, both inside and past the fattened boxes, and removals keep
+// the tree in step with the bodies
+void test_queries_match_scan() {
+  rng_t *rng = rng_init(11);
+  scene_t *scene = scene_init();
+  for (size_t id = 0; id < BODIES; id++) {
+    vector_t center = {random_between(rng, 0, 800),
+                       random_between(rng, 0, 800)};
+    scene_add_body(scene,
+                   tagged_box(center, random_between(rng, 1, 40), 1, id));
+  }
+  check_queries(scene, rng);
+  for (size_t round = 0; round < ROUNDS; round++) {
+    for (size_t i = 0; i < scene_bodies(scene); i++) {
+      // mostly small nudges that stay inside the margin, some long jumps
+      double speed = rng_range(rng, 4) == 0 ? 200 : 3;
+      body_set_velocity(scene_get_body(scene, i),
+                        (vector_t){random_between(rng, -speed, speed),
+                                   random_between(rng, -speed, speed)});
+    }
+    if (scene_bodies(scene) > 20) {
+      scene_remove_body(scene, rng_range(rng, scene_bodies(scene)));
+      scene_remove_body(scene, rng_range(rng, scene_bodies(scene)));
+    }
+    scene_tick(scene, 1);
+    check_queries(scene, rng);
+  }
+  assert(scene_bodies(scene) < BODIES);
+  scene_free(scene);
+  rng_free(rng);
+}
+
+void test_empty_scene_queries() {
+  scene_t *scene = scene_init();
+  hits_t hits;
+  hits_clear(&hits, 0);
+  scene_query_aabb(scene, (vector_t){-10, -10}, (vector_t){10, 10},
+                   record_hit, &hits);
+  scene_query_radius(scene, (vector_t){0, 0}, 100, record_hit, &hits);
+  scene_raycast(scene, (vector_t){0, 0}, (vector_t){1, 1}, 100,
+                record_ray_hit, &hits);
+  assert(hits.total == 0);
+  scene_free(scene);
+}
+
+void test_raycast() {
+  scene_t *scene = scene_init();
+  // boxes of side 4 centred on x = 10, 30 and 50 along the x axis
+  for (size_t id = 0; id < 3; id++) {
+    scene_add_body(scene, tagged_box((vector_t){10 + 20 * id, 0}, 4, 1, id));
+  }
+  hits_t hits;
+  hits_clear(&hits, 0);
+  scene_raycast(scene, (vector_t){0, 0}, (vector_t){2, 0}, 100,
+                record_ray_hit, &hits);
+  assert(hits.total == 3);
+  assert(fabs(hits.distances[0] - 8) < 1e-9);
+  assert(fabs(hits.distances[1] - 28) < 1e-9);
+  assert(fabs(hits.distances[2] - 48) < 1e-9);
+
+  // max_distance cuts off the last box
+  hits_clear(&hits, 0);
+  scene_raycast(scene, (vector_t){0, 0}, (vector_t){1, 0}, 40,
+                record_ray_hit, &hits);
+  assert(hits.total == 2 && hits.counts[2] == 0);
+
+  // straight up, with a zero x component, through the middle box only
+  hits_clear(&hits, 0);
+  scene_raycast(scene, (vector_t){30, -20}, (vector_t){0, 5}, 100,
+                record_ray_hit, &hits);
+  assert(hits.total == 1 && hits.counts[1] == 1);
+  assert(fabs(hits.distances[1] - 18) < 1e-9);
+
+  // diagonal, entering the first box through its corner
+  hits_clear(&hits, 0);
+  scene_raycast(scene, (vector_t){0, -10}, (vector_t){1, 1}, 100,
+                record_ray_hit, &hits);
+  assert(hits.total == 1 && hits.counts[0] == 1);
+  assert(fabs(hits.distances[0] - 8 * sqrt(2)) < 1e-9);
+
+  // pointing away, or with no direction at all, hits nothing
+  hits_clear(&hits, 0);
+  scene_raycast(scene, (vector_t){0, 0}, (vector_t){-1, 0}, 100,
+                record_ray_hit, &hits);
+  scene_raycast(scene, (vector_t){0, 0}, (vector_t){0, 0}, 100,
+                record_ray_hit, &hits);
+  assert(hits.total == 0);
+
+  // an origin inside a box hits it at distance zero
+  hits_clear(&hits, 0);
+  scene_raycast(scene, (vector_t){30, 0}, (vector_t){1, 0}, 5,
+                record_ray_hit, &hits);
+  assert(hits.total == 1 && hits.distances[1] == 0);
+  scene_free(scene);
+}
+
+// a handler returning false ends the query
+void test_query_stops() {
+  scene_t *scene = scene_init();
+  for (size_t id = 0; id < 10; id++) {
+    scene_add_body(scene, tagged_box((vector_t){id * 5, 0}, 4, 1, id));
+  }
+  hits_t hits;
+  hits_clear(&hits, 1);
+  scene_query_aabb(scene, (vector_t){-100, -100}, (vector_t){100, 100},
+                   record_hit, &hits);
+  assert(hits.total == 1);
+  hits_clear(&hits, 3);
+  scene_query_radius(scene, (vector_t){20, 0}, 100, record_hit, &hits);
+  assert(hits.total == 3);
+  hits_clear(&hits, 2);
+  scene_raycast(scene, (vector_t){-10, 0}, (vector_t){1, 0}, 100,
+                record_ray_hit, &hits);
+  assert(hits.total == 2);
+  scene_free(scene);
+}
+
+bool scene_has(scene_t *scene, size_t id) {
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    if (body_id(scene_get_body(scene, i)) == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void test_despawn() {
+  scene_t *scene = scene_init();
+  scene_set_despawn_policy(scene, (vector_t){0, 0}, (vector_t){100, 100}, 10,
+                           3);
+  // persistent bodies are never despawned, even far outside the area
+  scene_add_body(scene, tagged_box((vector_t){500, 500}, 2, 1, 0));
+  scene_add_body_with_lifetime(scene, tagged_box((vector_t){50, 50}, 2, 1, 1),
+                               1, 0);
+  // just inside the margin, then pushed out of it
+  scene_add_body_with_lifetime(scene, tagged_box((vector_t){105, 50}, 2, 1, 2),
+                               INFINITY, 0);
+  scene_tick(scene, 0.5);
+  assert(scene_has(scene, 0) && scene_has(scene, 1) && scene_has(scene, 2));
+  body_set_velocity(scene_get_body(scene, 2), (vector_t){20, 0});
+  scene_tick(scene, 0.5);
+  // body 1 reached its lifetime and body 2 left the area
+  assert(scene_bodies(scene) == 1 && scene_has(scene, 0));
+
+  // over the cap, the lowest priority goes first, the oldest within it
+  scene_add_body_with_lifetime(scene, tagged_box((vector_t){10, 10}, 2, 1, 3),
+                               INFINITY, 0);
+  scene_tick(scene, 0.1);
+  scene_add_body_with_lifetime(scene, tagged_box((vector_t){20, 10}, 2, 1, 4),
+                               INFINITY, 0);
+  scene_add_body_with_lifetime(scene, tagged_box((vector_t){30, 10}, 2, 1, 5),
+                               INFINITY, 1);
+  scene_add_body_with_lifetime(scene, tagged_box((vector_t){40, 10}, 2, 1, 6),
+                               INFINITY, 2);
+  scene_tick(scene, 0.1);
+  assert(scene_bodies(scene) == 4);
+  scene_add_body_with_lifetime(scene, tagged_box((vector_t){50, 10}, 2, 1, 7),
+                               INFINITY, 0);
+  scene_tick(scene, 0.1);
+  assert(scene_bodies(scene) == 4);
+  assert(scene_has(scene, 0) && !scene_has(scene, 3) &&
+         !scene_has(scene, 4) && scene_has(scene, 5) && scene_has(scene, 6) &&
+         scene_has(scene, 7));
+  // the removed bodies are out of the tree too
+  hits_t hits;
+  hits_clear(&hits, 0);
+  scene_query_aabb(scene, (vector_t){0, 0}, (vector_t){100, 100}, record_hit,
+                   &hits);
+  assert(hits.total == 3);
+  scene_free(scene);
+}
+
+void test_template_recycles() {
+  size_t *info = malloc(sizeof(size_t));
+  assert(info != NULL);
+  *info = 42;
+  body_template_t *template = template_init(
+      rectangle((vector_t){0, 0}, 4, 2), 3, GRAY, info, free, NULL, 2);
+  scene_t *scene = scene_init();
+  body_t *first = template_spawn(template, (vector_t){10, 20});
+  body_t *second = template_spawn(template, (vector_t){-5, 0});
+  assert(first != second);
+  assert(vec_isclose(body_get_centroid(first), (vector_t){10, 20}));
+  assert(body_get_mass(first) == 3);
+  assert(body_get_info(first) == info && body_get_info(second) == info);
+  vector_t min, max;
+  body_get_bounds(second, &min, &max);
+  assert(vec_isclose(min, (vector_t){-7, -1}));
+  assert(vec_isclose(max, (vector_t){-3, 1}));
+  scene_add_body(scene, first);
+  scene_add_body(scene, second);
+
+  // a removed body goes back to its template and is handed out again, reset
+  body_set_velocity(first, (vector_t){5, 5});
+  scene_remove_body(scene, 0);
+  scene_tick(scene, 1);
+  assert(scene_bodies(scene) == 1);
+  body_t *again = template_spawn(template, (vector_t){1, 1});
+  assert(again == first);
+  assert(!body_is_removed(again));
+  assert(vec_isclose(body_get_centroid(again), (vector_t){1, 1}));
+  assert(vec_isclose(body_get_velocity(again), (vector_t){0, 0}));
+  scene_add_body(scene, again);
+  // the scene has to go before the template its bodies recycle into
+  scene_free(scene);
+  template_free(template);
+}
+
+bool in_region(vector_t point, vector_t min, vector_t max) {
+  return point.x >= min.x && point.y >= min.y && point.x < max.x &&
+         point.y < max.y;
+}
+
+void test_placement_spacing() {
+  vector_t min = {0, 0}, max = {400, 300};
+  double spacing = 30;
+  rng_t *rng = rng_init(5);
+  scene_t *scene = scene_init();
+  // static scenery covering everything doesn't count
+  scene_add_body(scene, body_init(rectangle((vector_t){200, 150}, 400, 300),
+                                  INFINITY, GRAY, NULL));
+  placement_t *placement = placement_init(min, max, spacing, 10, rng);
+  vector_t points[20];
+  for (size_t i = 0; i < 20; i++) {
+    assert(placement_sample(placement, scene, &points[i]));
+    assert(in_region(points[i], min, max));
+    // clear of every live body placed so far
+    for (size_t b = 1; b < scene_bodies(scene); b++) {
+      vector_t body_min, body_max;
+      body_get_bounds(scene_get_body(scene, b), &body_min, &body_max);
+      assert(box_distance_squared(body_min, body_max, points[i]) >
+             spacing * spacing);
+    }
+    // and blue noise within a pool
+    for (size_t j = 0; j < i; j++) {
+      vector_t offset = vec_subtract(points[i], points[j]);
+      assert(vec_dot(offset, offset) >= spacing * spacing);
+    }
+    scene_add_body(scene, body_init(rectangle(points[i], 2, 2), 1, GRAY,
+                                    NULL));
+  }
+
+  // a moving body over the whole region leaves nowhere to spawn
+  scene_add_body(scene, body_init(rectangle((vector_t){200, 150}, 500, 400),
+                                  1, GRAY, NULL));
+  vector_t blocked;
+  assert(!placement_sample(placement, scene, &blocked));
+  placement_free(placement);
+  scene_free(scene);
+  rng_free(rng);
+}
+
+void test_placement_same_seed() {
+  vector_t min = {0, 0}, max = {200, 200};
+  rng_t *a_rng = rng_init(9), *b_rng = rng_init(9);
+  scene_t *scene = scene_init();
+  placement_t *a = placement_init(min, max, 15, 5, a_rng);
+  placement_t *b = placement_init(min, max, 15, 5, b_rng);
+  for (size_t i = 0; i < 50; i++) {
+    vector_t a_point, b_point;
+    assert(placement_sample(a, scene, &a_point));
+    assert(placement_sample(b, scene, &b_point));
+    assert(a_point.x == b_point.x && a_point.y == b_point.y);
+  }
+  placement_free(a);
+  placement_free(b);
+  scene_free(scene);
+  rng_free(a_rng);
+  rng_free(b_rng);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_queries_match_scan)
+  DO_TEST(test_empty_scene_queries)
+  DO_TEST(test_raycast)
+  DO_TEST(test_query_stops)
+  DO_TEST(test_despawn)
+  DO_TEST(test_template_recycles)
+  DO_TEST(test_placement_spacing)
+  DO_TEST(test_placement_same_seed)
+
+  puts("scene_test PASS");
+}
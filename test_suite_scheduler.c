@@ -0,0 +1,113 @@
+#include "rng.h"
+#include "scheduler.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+void count_fire(void *aux) { (*(size_t *)aux)++; }
+
+void test_empty() {
+  rng_t *rng = rng_init(1);
+  scheduler_t *scheduler = scheduler_init(4, rng);
+  assert(isinf(scheduler_next_due(scheduler)));
+  scheduler_advance(scheduler, 100);
+  assert(isinf(scheduler_next_due(scheduler)));
+  scheduler_free(scheduler);
+  rng_free(rng);
+}
+
+void test_due_after_now() {
+  rng_t *rng = rng_init(2);
+  scheduler_t *scheduler = scheduler_init(1, rng);
+  size_t fired = 0;
+  scheduler_add(scheduler, 3, 0, count_fire, &fired);
+  scheduler_add(scheduler, 5, 0, count_fire, &fired);
+  assert(scheduler_next_due(scheduler) > 0);
+  double due = scheduler_next_due(scheduler);
+  // fine steps and coarse jumps both leave nothing overdue
+  for (double now = 0.01; now < 20; now += now < 10 ? 0.01 : 2.5) {
+    scheduler_advance(scheduler, now);
+    assert(scheduler_next_due(scheduler) > now);
+    assert(scheduler_next_due(scheduler) >= due);
+    due = scheduler_next_due(scheduler);
+  }
+  assert(fired > 0);
+  scheduler_free(scheduler);
+  rng_free(rng);
+}
+
+#define SPAWNERS 37
+
+// the heap starts with one slot and has to grow to hold every spawner
+void test_grows() {
+  rng_t *rng = rng_init(3);
+  scheduler_t *scheduler = scheduler_init(1, rng);
+  size_t fired[SPAWNERS] = {0};
+  for (size_t i = 0; i < SPAWNERS; i++) {
+    scheduler_add(scheduler, 1, 0, count_fire, &fired[i]);
+  }
+  scheduler_advance(scheduler, 1000);
+  for (size_t i = 0; i < SPAWNERS; i++) {
+    assert(fired[i] > 800 && fired[i] < 1200);
+  }
+  scheduler_free(scheduler);
+  rng_free(rng);
+}
+
+void test_rates() {
+  rng_t *rng = rng_init(4);
+  scheduler_t *scheduler = scheduler_init(2, rng);
+  size_t slow = 0, fast = 0;
+  scheduler_add(scheduler, 2, 0, count_fire, &slow);
+  scheduler_add(scheduler, 8, 0, count_fire, &fast);
+  scheduler_advance(scheduler, 1000);
+  // 2000 and 8000 expected; a poisson count strays by about its square root
+  assert(fabs(slow - 2000.0) < 250);
+  assert(fabs(fast - 8000.0) < 500);
+  scheduler_free(scheduler);
+  rng_free(rng);
+}
+
+size_t fire_count(uint64_t seed, double *last_due) {
+  rng_t *rng = rng_init(seed);
+  scheduler_t *scheduler = scheduler_init(2, rng);
+  size_t fired = 0;
+  scheduler_add(scheduler, 1.5, 0, count_fire, &fired);
+  scheduler_add(scheduler, 0.5, 0, count_fire, &fired);
+  for (double now = 0; now < 100; now += 0.25) {
+    scheduler_advance(scheduler, now);
+  }
+  *last_due = scheduler_next_due(scheduler);
+  scheduler_free(scheduler);
+  rng_free(rng);
+  return fired;
+}
+
+void test_same_seed() {
+  double a_due, b_due, c_due;
+  size_t a = fire_count(5, &a_due);
+  size_t b = fire_count(5, &b_due);
+  fire_count(6, &c_due);
+  assert(a == b);
+  assert(a_due == b_due);
+  assert(a_due != c_due);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_empty)
+  DO_TEST(test_due_after_now)
+  DO_TEST(test_grows)
+  DO_TEST(test_rates)
+  DO_TEST(test_same_seed)
+
+  puts("scheduler_test PASS");
+}
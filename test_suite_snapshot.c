@@ -0,0 +1,233 @@
+#include "body.h"
+#include "forces.h"
+#include "geometry.h"
+#include "list.h"
+#include "polygon.h"
+#include "scene.h"
+#include "snapshot.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+const rgb_color_t RED = {.r = 1, .g = 0, .b = 0};
+const rgb_color_t BLUE = {.r = 0, .g = 0, .b = 1};
+
+list_t *triangle(double size) {
+  list_t *shape = list_init(3, free);
+  vector_t corners[] = {{0, 0}, {size, 0}, {0, size}};
+  for (size_t i = 0; i < 3; i++) {
+    vector_t *v = malloc(sizeof(vector_t));
+    assert(v != NULL);
+    *v = corners[i];
+    list_add(shape, v);
+  }
+  return shape;
+}
+
+uint32_t encode_tag(void *info) { return *(uint32_t *)info; }
+
+void *decode_tag(uint32_t tag) {
+  uint32_t *info = malloc(sizeof(uint32_t));
+  assert(info != NULL);
+  *info = tag;
+  return info;
+}
+
+// a scene exercising everything a snapshot stores: shared geometry and
+// textures, info tags, lifetimes, despawning, the rng and several force kinds
+scene_t *make_scene() {
+  scene_t *scene = scene_init();
+  scene_seed(scene, 7);
+  scene_set_despawn_policy(scene, (vector_t){-100, -100},
+                           (vector_t){100, 100}, 10, 50);
+  list_t *shape = triangle(2);
+  geometry_t *rock = geometry_init(shape, polygon_centroid(shape));
+  list_free(shape);
+  for (size_t i = 0; i < 4; i++) {
+    body_t *body = body_init_with_geometry(rock, 3, RED, NULL, NULL,
+                                           "assets/rock.png");
+    body_set_centroid(body, (vector_t){i * 10, 0});
+    scene_add_body(scene, body);
+  }
+  geometry_release(rock);
+  scene_add_body(scene, body_init_with_info(triangle(5), 2, BLUE,
+                                            decode_tag(17), free,
+                                            "assets/rock.png"));
+  scene_add_body(scene, body_init(triangle(8), INFINITY, BLUE, NULL));
+  scene_add_body_with_lifetime(
+      scene, body_init(triangle(1), 1, RED, "assets/coin.png"), 2.5, 1);
+  // far enough away that nothing collides yet
+  body_set_centroid(scene_get_body(scene, 6), (vector_t){60, 60});
+  body_set_velocity(scene_get_body(scene, 0), (vector_t){3, -1});
+  body_set_rotation(scene_get_body(scene, 1), 0.5);
+
+  create_newtonian_gravity(scene, 5, scene_get_body(scene, 0),
+                           scene_get_body(scene, 1));
+  create_spring(scene, 2, scene_get_body(scene, 1), scene_get_body(scene, 2));
+  create_drag(scene, 0.25, scene_get_body(scene, 3));
+  create_physics_collision(scene, 0.8, scene_get_body(scene, 4),
+                           scene_get_body(scene, 5));
+  create_destructive_collision(scene, scene_get_body(scene, 0),
+                               scene_get_body(scene, 6));
+  return scene;
+}
+
+snapshot_t *take(scene_t *scene) {
+  snapshot_t *snapshot = snapshot_init(256);
+  scene_snapshot(scene, snapshot, encode_tag);
+  return snapshot;
+}
+
+void assert_same_bytes(snapshot_t *a, snapshot_t *b) {
+  assert(snapshot_size(a) == snapshot_size(b));
+  assert(memcmp(snapshot_data(a), snapshot_data(b), snapshot_size(a)) == 0);
+}
+
+void test_round_trip() {
+  scene_t *scene = make_scene();
+  scene_tick(scene, 0.1);
+  snapshot_t *first = take(scene);
+  scene_t *restored =
+      scene_restore(snapshot_data(first), snapshot_size(first), decode_tag,
+                    free);
+  assert(restored != NULL);
+  assert(scene_bodies(restored) == scene_bodies(scene));
+  assert(scene_forces(restored) == scene_forces(scene));
+  assert(scene_get_time(restored) == scene_get_time(scene));
+  assert(*(uint32_t *)body_get_info(scene_get_body(restored, 4)) == 17);
+  snapshot_t *second = take(restored);
+  assert_same_bytes(first, second);
+  assert(snapshot_hash(first) == snapshot_hash(second));
+  snapshot_free(first);
+  snapshot_free(second);
+  scene_free(restored);
+  scene_free(scene);
+}
+
+// the restored scene carries on exactly as the original would have
+void test_restored_ticks_the_same() {
+  scene_t *scene = make_scene();
+  snapshot_t *snapshot = take(scene);
+  scene_t *restored = scene_restore(snapshot_data(snapshot),
+                                    snapshot_size(snapshot), decode_tag, free);
+  assert(restored != NULL);
+  for (size_t i = 0; i < 50; i++) {
+    scene_tick(scene, 0.05);
+    scene_tick(restored, 0.05);
+  }
+  snapshot_t *original = take(scene);
+  snapshot_t *replayed = take(restored);
+  assert_same_bytes(original, replayed);
+  snapshot_free(snapshot);
+  snapshot_free(original);
+  snapshot_free(replayed);
+  scene_free(restored);
+  scene_free(scene);
+}
+
+void test_empty_scene() {
+  scene_t *scene = scene_init();
+  snapshot_t *first = take(scene);
+  scene_t *restored =
+      scene_restore(snapshot_data(first), snapshot_size(first), NULL, NULL);
+  assert(restored != NULL);
+  assert(scene_bodies(restored) == 0);
+  snapshot_t *second = take(restored);
+  assert_same_bytes(first, second);
+  snapshot_free(first);
+  snapshot_free(second);
+  scene_free(restored);
+  scene_free(scene);
+}
+
+scene_t *restore_copy(snapshot_t *snapshot, size_t size,
+                      void (*corrupt)(uint8_t *bytes)) {
+  uint8_t *bytes = malloc(snapshot_size(snapshot));
+  assert(bytes != NULL);
+  memcpy(bytes, snapshot_data(snapshot), snapshot_size(snapshot));
+  if (corrupt != NULL) {
+    corrupt(bytes);
+  }
+  scene_t *scene = scene_restore(bytes, size, decode_tag, free);
+  free(bytes);
+  return scene;
+}
+
+void bad_magic(uint8_t *bytes) { bytes[0] ^= 0xff; }
+
+void bad_version(uint8_t *bytes) { bytes[4]++; }
+
+void huge_body_count(uint8_t *bytes) {
+  uint32_t count = UINT32_MAX / 2;
+  memcpy(bytes + 8, &count, sizeof(count));
+}
+
+void huge_force_count(uint8_t *bytes) {
+  uint32_t count = 1000000;
+  memcpy(bytes + 12, &count, sizeof(count));
+}
+
+// the drag force is the only one acting on a single body, so its record is
+// the one without a second body
+void one_body_force_with_second(uint8_t *bytes) {
+  uint32_t count;
+  uint64_t offset;
+  memcpy(&count, bytes + 12, sizeof(count));
+  memcpy(&offset, bytes + 32, sizeof(offset));
+  size_t found = 0;
+  for (size_t f = 0; f < count; f++) {
+    // kind, body1, body2, collided, then the constant
+    uint8_t *body2 = bytes + offset + f * 24 + 8;
+    uint32_t index;
+    memcpy(&index, body2, sizeof(index));
+    if (index == UINT32_MAX) {
+      index = 1000;
+      memcpy(body2, &index, sizeof(index));
+      found++;
+    }
+  }
+  assert(found == 1);
+}
+
+void test_rejects_corrupt() {
+  scene_t *scene = make_scene();
+  snapshot_t *snapshot = take(scene);
+  size_t size = snapshot_size(snapshot);
+  assert(scene_restore(snapshot_data(snapshot), 0, decode_tag, free) == NULL);
+  assert(scene_restore(snapshot_data(snapshot), 16, decode_tag, free) ==
+         NULL);
+  // cut off anywhere, some record or string no longer fits
+  for (size_t cut = 8; cut <= size; cut += 8) {
+    assert(restore_copy(snapshot, size - cut, NULL) == NULL);
+  }
+  assert(restore_copy(snapshot, size, bad_magic) == NULL);
+  assert(restore_copy(snapshot, size, bad_version) == NULL);
+  assert(restore_copy(snapshot, size, huge_body_count) == NULL);
+  assert(restore_copy(snapshot, size, huge_force_count) == NULL);
+  assert(restore_copy(snapshot, size, one_body_force_with_second) == NULL);
+  // the untouched copy still restores
+  scene_t *restored = restore_copy(snapshot, size, NULL);
+  assert(restored != NULL);
+  scene_free(restored);
+  snapshot_free(snapshot);
+  scene_free(scene);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_round_trip)
+  DO_TEST(test_restored_ticks_the_same)
+  DO_TEST(test_empty_scene)
+  DO_TEST(test_rejects_corrupt)
+
+  puts("snapshot_test PASS");
+}
@@ -0,0 +1,99 @@
+#include "texture.h"
+#include "vector.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Interns texture paths to small integer ids so renderers can index a table
+// instead of comparing strings. Ids are handed out in registration order and
+// never reused. Every access takes the lock: the batch runner builds games on
+// several threads, and with a simulation thread, bodies are interned while
+// the render thread looks textures up.
+
+const size_t INITIAL_TEXTURES = 16;
+// what the renderer drew textures it had no size for before the registry
+const vector_t DEFAULT_TEXTURE_SIZE = (vector_t){.x = 100, .y = 100};
+
+typedef struct texture_entry {
+  char *path;
+  vector_t size;
+} texture_entry_t;
+
+texture_entry_t *entries = NULL;
+size_t entry_count = 0;
+size_t entry_capacity = 0;
+pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+size_t texture_intern(const char *path) {
+  if (path == NULL) {
+    return NO_TEXTURE;
+  }
+  pthread_mutex_lock(&registry_lock);
+  // a game uses a handful of textures, so a scan beats hashing here
+  for (size_t id = 0; id < entry_count; id++) {
+    if (strcmp(entries[id].path, path) == 0) {
+      pthread_mutex_unlock(&registry_lock);
+      return id;
+    }
+  }
+  if (entry_count == entry_capacity) {
+    entry_capacity =
+        entry_capacity > 0 ? entry_capacity * 2 : INITIAL_TEXTURES;
+    entries = realloc(entries, sizeof(texture_entry_t) * entry_capacity);
+    assert(entries != NULL);
+  }
+  size_t id = entry_count;
+  entries[id].path = strdup(path);
+  assert(entries[id].path != NULL);
+  entries[id].size = DEFAULT_TEXTURE_SIZE;
+  entry_count++;
+  pthread_mutex_unlock(&registry_lock);
+  return id;
+}
+
+// interns path and sets the size it's drawn at
+size_t texture_register(const char *path, vector_t size) {
+  size_t id = texture_intern(path);
+  assert(id != NO_TEXTURE);
+  pthread_mutex_lock(&registry_lock);
+  entries[id].size = size;
+  pthread_mutex_unlock(&registry_lock);
+  return id;
+}
+
+size_t texture_count(void) {
+  pthread_mutex_lock(&registry_lock);
+  size_t count = entry_count;
+  pthread_mutex_unlock(&registry_lock);
+  return count;
+}
+
+// paths aren't moved when the table grows, so this stays valid
+const char *texture_get_path(size_t id) {
+  pthread_mutex_lock(&registry_lock);
+  assert(id < entry_count);
+  const char *path = entries[id].path;
+  pthread_mutex_unlock(&registry_lock);
+  return path;
+}
+
+vector_t texture_get_size(size_t id) {
+  pthread_mutex_lock(&registry_lock);
+  assert(id < entry_count);
+  vector_t size = entries[id].size;
+  pthread_mutex_unlock(&registry_lock);
+  return size;
+}
+
+void texture_registry_free(void) {
+  pthread_mutex_lock(&registry_lock);
+  for (size_t id = 0; id < entry_count; id++) {
+    free(entries[id].path);
+  }
+  free(entries);
+  entries = NULL;
+  entry_count = 0;
+  entry_capacity = 0;
+  pthread_mutex_unlock(&registry_lock);
+}
@@ -0,0 +1,231 @@
+#include "trace.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Chrome trace event writer. Each thread appends begin/end events to its own
+// single-producer ring without locking; a background thread drains every ring
+// into a JSON array that chrome://tracing and Perfetto load directly. The
+// closing bracket is optional in that format, so the file can be opened after
+// any flush, even while the game is still running.
+
+// events per thread; a frame during a spawn storm emits a few thousand
+#define TRACE_RING_SIZE (1 << 16)
+#define MAX_TRACE_THREADS 64
+// how often the flusher drains the rings when nobody asks it to
+const long TRACE_FLUSH_INTERVAL_NS = 50 * 1000 * 1000;
+
+typedef struct trace_event {
+  // must outlive the trace; every caller passes string literals
+  const char *name;
+  char phase;
+  double timestamp;
+} trace_event_t;
+
+typedef struct trace_ring {
+  trace_event_t events[TRACE_RING_SIZE];
+  uint32_t thread;
+  // head is written only by the owning thread, tail only by the flusher
+  atomic_size_t head;
+  atomic_size_t tail;
+  atomic_size_t dropped;
+} trace_ring_t;
+
+/**
+ * Whether events are being recorded. Checked on every event, so it's the only
+ * cost of tracing when it's off.
+ */
+atomic_bool tracing = false;
+/**
+ * Bumped by every trace_start() so threads re-register rings left over from
+ * an earlier trace.
+ */
+atomic_uint trace_generation = 0;
+_Thread_local trace_ring_t *thread_ring = NULL;
+_Thread_local unsigned thread_generation = 0;
+
+trace_ring_t *_Atomic rings[MAX_TRACE_THREADS];
+atomic_size_t ring_count = 0;
+
+FILE *trace_file = NULL;
+double trace_start_time = 0;
+bool first_event = true;
+pthread_t flusher;
+pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t flush_wake = PTHREAD_COND_INITIALIZER;
+bool flush_requested = false;
+bool stop_requested = false;
+
+double trace_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// NULL once MAX_TRACE_THREADS threads have traced; their events are dropped
+trace_ring_t *trace_thread_ring(void) {
+  unsigned generation = atomic_load(&trace_generation);
+  if (thread_ring != NULL && thread_generation == generation) {
+    return thread_ring;
+  }
+  thread_ring = NULL;
+  thread_generation = generation;
+  size_t index = atomic_fetch_add(&ring_count, 1);
+  if (index >= MAX_TRACE_THREADS) {
+    return NULL;
+  }
+  trace_ring_t *ring = malloc(sizeof(trace_ring_t));
+  assert(ring != NULL);
+  ring->thread = index + 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->dropped, 0);
+  atomic_store(&rings[index], ring);
+  thread_ring = ring;
+  return ring;
+}
+
+void trace_push(const char *name, char phase) {
+  if (!atomic_load_explicit(&tracing, memory_order_relaxed)) {
+    return;
+  }
+  trace_ring_t *ring = trace_thread_ring();
+  if (ring == NULL) {
+    return;
+  }
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail == TRACE_RING_SIZE) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  trace_event_t *event = &ring->events[head % TRACE_RING_SIZE];
+  event->name = name;
+  event->phase = phase;
+  event->timestamp = trace_now();
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_begin(const char *name) { trace_push(name, 'B'); }
+
+void trace_end(const char *name) { trace_push(name, 'E'); }
+
+bool trace_is_enabled(void) {
+  return atomic_load_explicit(&tracing, memory_order_relaxed);
+}
+
+// only called from the flusher, or after it has been joined
+void trace_drain(void) {
+  size_t count = atomic_load(&ring_count);
+  for (size_t r = 0; r < count && r < MAX_TRACE_THREADS; r++) {
+    trace_ring_t *ring = atomic_load(&rings[r]);
+    // registered but not yet published
+    if (ring == NULL) {
+      continue;
+    }
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (; tail != head; tail++) {
+      trace_event_t *event = &ring->events[tail % TRACE_RING_SIZE];
+      fprintf(trace_file,
+              "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,"
+              "\"tid\":%u}",
+              first_event ? "" : ",\n", event->name, event->phase,
+              (event->timestamp - trace_start_time) * 1e6, ring->thread);
+      first_event = false;
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  }
+}
+
+void *trace_flusher(void *aux) {
+  pthread_mutex_lock(&flush_lock);
+  while (!stop_requested) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += TRACE_FLUSH_INTERVAL_NS;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&flush_wake, &flush_lock, &deadline);
+    bool requested = flush_requested;
+    flush_requested = false;
+    // writing can be slow, so don't hold up trace_flush() callers meanwhile
+    pthread_mutex_unlock(&flush_lock);
+    trace_drain();
+    if (requested) {
+      fflush(trace_file);
+    }
+    pthread_mutex_lock(&flush_lock);
+  }
+  pthread_mutex_unlock(&flush_lock);
+  return NULL;
+}
+
+// -1 = couldn't open path, 0 = okay
+int trace_start(const char *path) {
+  assert(trace_file == NULL);
+  trace_file = fopen(path, "w");
+  if (trace_file == NULL) {
+    return -1;
+  }
+  fprintf(trace_file, "[\n");
+  trace_start_time = trace_now();
+  first_event = true;
+  stop_requested = false;
+  flush_requested = false;
+  atomic_store(&ring_count, 0);
+  atomic_fetch_add(&trace_generation, 1);
+  int created = pthread_create(&flusher, NULL, trace_flusher, NULL);
+  assert(created == 0);
+  atomic_store(&tracing, true);
+  return 0;
+}
+
+// asks the flusher to write out everything recorded so far without waiting
+// for it
+void trace_flush(void) {
+  if (trace_file == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&flush_lock);
+  flush_requested = true;
+  pthread_cond_signal(&flush_wake);
+  pthread_mutex_unlock(&flush_lock);
+}
+
+// writes the remaining events and closes the file; threads other than the
+// caller must have stopped tracing by now
+void trace_stop(void) {
+  if (trace_file == NULL) {
+    return;
+  }
+  atomic_store(&tracing, false);
+  pthread_mutex_lock(&flush_lock);
+  stop_requested = true;
+  pthread_cond_signal(&flush_wake);
+  pthread_mutex_unlock(&flush_lock);
+  pthread_join(flusher, NULL);
+  trace_drain();
+  size_t dropped = 0;
+  size_t count = atomic_load(&ring_count);
+  for (size_t r = 0; r < count && r < MAX_TRACE_THREADS; r++) {
+    trace_ring_t *ring = atomic_exchange(&rings[r], NULL);
+    if (ring != NULL) {
+      dropped += atomic_load(&ring->dropped);
+      free(ring);
+    }
+  }
+  fprintf(trace_file, "\n]\n");
+  fclose(trace_file);
+  trace_file = NULL;
+  if (dropped > 0) {
+    fprintf(stderr, "trace dropped %zu events\n", dropped);
+  }
+}